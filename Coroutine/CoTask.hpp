@@ -0,0 +1,264 @@
+#pragma once
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <type_traits>
+
+// Lazily started coroutine that produces a T
+// The coroutine starts when it is awaited. The awaiting coroutine is suspended and resumed by symmetric transfer
+// on the thread that finishes the CoTask, e.g. a pool worker after co_await pool.schedule()
+// No thread blocks while a CoTask is in flight. syncWait() is the only blocking entry point
+/* Usage:
+CoTask<int> square(ThreadPool& pool, int x) {
+	co_await pool.schedule(); // Continue on a worker
+	co_return x * x;
+}
+CoTask<int> sum(ThreadPool& pool) {
+	int a = co_await square(pool, 2);
+	int b = co_await square(pool, 3);
+	co_return a + b;
+}
+int result = syncWait(sum(pool));
+*/
+template <class T = void>
+class CoTask;
+
+namespace detail {
+	// Resumes the coroutine that awaited the finished CoTask
+	struct ContinuationAwaiter {
+		bool await_ready() const noexcept { return false; }
+		template <class Promise>
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+			return handle.promise().continuation;
+		}
+		void await_resume() const noexcept {}
+	};
+
+	struct CoTaskPromiseBase {
+		std::coroutine_handle<> continuation{ std::noop_coroutine() };
+		std::exception_ptr exception;
+		std::suspend_always initial_suspend() const noexcept { return {}; }
+		ContinuationAwaiter final_suspend() const noexcept { return {}; }
+		void unhandled_exception() { exception = std::current_exception(); }
+	};
+
+	template <class T>
+	struct CoTaskPromise : CoTaskPromiseBase {
+		std::optional<T> value;
+		CoTask<T> get_return_object();
+		template <class U>
+		void return_value(U&& result) { value.emplace(std::forward<U>(result)); }
+		T takeResult() {
+			if (exception)
+				std::rethrow_exception(exception);
+			return std::move(*value);
+		}
+	};
+
+	template <>
+	struct CoTaskPromise<void> : CoTaskPromiseBase {
+		CoTask<void> get_return_object();
+		void return_void() {}
+		void takeResult() {
+			if (exception)
+				std::rethrow_exception(exception);
+		}
+	};
+}
+
+template <class T>
+class CoTask
+{
+public:
+	using promise_type = detail::CoTaskPromise<T>;
+	using Handle = std::coroutine_handle<promise_type>;
+private:
+	Handle m_handle;
+	// Starts the task and resumes the awaiting coroutine when it has finished
+	struct Awaiter {
+		Handle handle;
+		bool await_ready() const noexcept { return !handle || handle.done(); }
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+			handle.promise().continuation = awaiting;
+			return handle;
+		}
+	};
+	struct ResultAwaiter : Awaiter {
+		T await_resume() { return this->handle.promise().takeResult(); }
+	};
+	struct ReadyAwaiter : Awaiter {
+		void await_resume() const noexcept {}
+	};
+public:
+	explicit CoTask(Handle handle) : m_handle(handle) {}
+	CoTask(const CoTask&) = delete;
+	CoTask& operator=(const CoTask&) = delete;
+	CoTask(CoTask&& other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+	CoTask& operator=(CoTask&& other) noexcept {
+		if (this != &other) {
+			if (m_handle)
+				m_handle.destroy();
+			m_handle = std::exchange(other.m_handle, nullptr);
+		}
+		return *this;
+	}
+	~CoTask() {
+		if (m_handle)
+			m_handle.destroy();
+	}
+	// Run the task and get its result. Rethrows the exception thrown by the task
+	ResultAwaiter operator co_await() const noexcept { return ResultAwaiter{ { m_handle } }; }
+	// Run the task without taking its result or rethrowing its exception
+	ReadyAwaiter whenReady() const noexcept { return ReadyAwaiter{ { m_handle } }; }
+	bool isReady() const noexcept { return !m_handle || m_handle.done(); }
+	// Take the result of a finished task. Rethrows the exception thrown by the task
+	T takeResult() { return m_handle.promise().takeResult(); }
+};
+
+template <class T>
+CoTask<T> detail::CoTaskPromise<T>::get_return_object() {
+	return CoTask<T>(std::coroutine_handle<CoTaskPromise<T>>::from_promise(*this));
+}
+
+inline CoTask<void> detail::CoTaskPromise<void>::get_return_object() {
+	return CoTask<void>(std::coroutine_handle<CoTaskPromise<void>>::from_promise(*this));
+}
+
+namespace detail {
+	// Coroutine started by hand that runs a callback when it finishes. Used to await a CoTask from outside a coroutine
+	// The callback returns the coroutine to transfer to, so that a continuation does not run nested in the callback
+	class DetachedTask
+	{
+	public:
+		struct promise_type {
+			std::coroutine_handle<> (*onDone)(void* context){ nullptr };
+			void* context{ nullptr };
+			DetachedTask get_return_object() { return DetachedTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+			std::suspend_always initial_suspend() const noexcept { return {}; }
+			// Stay suspended so that the owner destroys the frame
+			auto final_suspend() const noexcept {
+				struct Awaiter {
+					bool await_ready() const noexcept { return false; }
+					std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) const noexcept {
+						return handle.promise().onDone(handle.promise().context);
+					}
+					void await_resume() const noexcept {}
+				};
+				return Awaiter{};
+			}
+			void return_void() {}
+			void unhandled_exception() { std::terminate(); }
+		};
+	private:
+		std::coroutine_handle<promise_type> m_handle;
+	public:
+		explicit DetachedTask(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+		DetachedTask(DetachedTask&& other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+		DetachedTask(const DetachedTask&) = delete;
+		DetachedTask& operator=(const DetachedTask&) = delete;
+		~DetachedTask() {
+			if (m_handle)
+				m_handle.destroy();
+		}
+		// Run until the first suspension. onDone(context) is called on the thread that finishes the coroutine
+		void start(std::coroutine_handle<> (*onDone)(void*), void* context) {
+			m_handle.promise().onDone = onDone;
+			m_handle.promise().context = context;
+			m_handle.resume();
+		}
+	};
+
+	template <class T>
+	DetachedTask awaitReady(const CoTask<T>& task) {
+		co_await task.whenReady();
+	}
+
+	// Set once from any thread. The waiter may destroy it as soon as wait() returns
+	struct SyncWaitEvent {
+		std::mutex mutex;
+		std::condition_variable cond;
+		bool done{ false };
+		static std::coroutine_handle<> set(void* context) {
+			auto* event = static_cast<SyncWaitEvent*>(context);
+			std::scoped_lock lock{event->mutex};
+			event->done = true;
+			event->cond.notify_all();
+			return std::noop_coroutine();
+		}
+		void wait() {
+			std::unique_lock lock{mutex};
+			cond.wait(lock, [this]() { return done; });
+		}
+	};
+
+	// Counts the unfinished tasks of whenAll() and resumes the awaiting coroutine after the last one
+	struct WhenAllCounter {
+		std::atomic<size_t> remaining;
+		std::coroutine_handle<> continuation;
+		static std::coroutine_handle<> finish(void* context) {
+			auto* counter = static_cast<WhenAllCounter*>(context);
+			if (counter->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				return counter->continuation;
+			return std::noop_coroutine();
+		}
+	};
+
+	// Starts every task and resumes the awaiting coroutine when all of them have finished
+	template <class T>
+	struct WhenAllAwaiter {
+		std::vector<CoTask<T>>& tasks;
+		std::vector<DetachedTask> waiters;
+		WhenAllCounter counter;
+		explicit WhenAllAwaiter(std::vector<CoTask<T>>& tasks_) : tasks(tasks_) {}
+		bool await_ready() const noexcept { return tasks.empty(); }
+		bool await_suspend(std::coroutine_handle<> awaiting) {
+			waiters.reserve(tasks.size());
+			for (auto& task : tasks)
+				waiters.push_back(awaitReady(task));
+			// One extra count keeps the coroutine from being resumed before every task has been started
+			counter.remaining.store(tasks.size() + 1, std::memory_order_relaxed);
+			counter.continuation = awaiting;
+			for (auto& waiter : waiters)
+				waiter.start(&WhenAllCounter::finish, &counter);
+			// Resume right away if every task finished during start()
+			return counter.remaining.fetch_sub(1, std::memory_order_acq_rel) != 1;
+		}
+		void await_resume() const noexcept {}
+	};
+}
+
+// Run the task on the calling thread until it suspends, then block until it finishes and return its result
+// Use it to enter coroutine code from ordinary code, e.g. main()
+template <class T>
+T syncWait(CoTask<T> task) {
+	detail::SyncWaitEvent event;
+	auto waiter = detail::awaitReady(task);
+	waiter.start(&detail::SyncWaitEvent::set, &event);
+	event.wait();
+	return task.takeResult();
+}
+
+// Run all tasks concurrently and get their results in order
+// The awaiting coroutine resumes on the thread that finishes the last task
+// If tasks throw, the exception of the first of them in order is rethrown after all have finished
+template <class T>
+CoTask<std::vector<T>> whenAll(std::vector<CoTask<T>> tasks) {
+	co_await detail::WhenAllAwaiter<T>(tasks);
+	std::vector<T> results;
+	results.reserve(tasks.size());
+	for (auto& task : tasks)
+		results.push_back(task.takeResult());
+	co_return results;
+}
+
+// Run all tasks concurrently
+inline CoTask<void> whenAll(std::vector<CoTask<void>> tasks) {
+	co_await detail::WhenAllAwaiter<void>(tasks);
+	for (auto& task : tasks)
+		task.takeResult();
+}
@@ -0,0 +1,88 @@
+#include "CoTask.hpp"
+#include "ThreadPool.hpp"
+#include "WSThreadPool.hpp"
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <cassert>
+
+// Number of handlers that have started but not finished, and the highest number seen
+struct InFlight {
+	std::atomic<size_t> current{0};
+	std::atomic<size_t> max{0};
+	void enter() {
+		size_t now = current.fetch_add(1) + 1;
+		size_t seen = max.load();
+		while (seen < now && !max.compare_exchange_weak(seen, now));
+	}
+	void leave() { current.fetch_sub(1); }
+};
+
+template <class Pool>
+CoTask<long long> square(Pool& pool, long long x) {
+	co_await pool.schedule();
+	co_return x * x;
+}
+
+// A request handler that awaits two operations without blocking a worker while they are pending
+template <class Pool>
+CoTask<long long> handleRequest(Pool& pool, long long id, InFlight& inFlight) {
+	co_await pool.schedule();
+	inFlight.enter();
+	long long a = co_await square(pool, id);
+	long long b = co_await square(pool, id + 1);
+	inFlight.leave();
+	co_return a + b;
+}
+
+template <class Pool>
+CoTask<void> fail(Pool& pool) {
+	co_await pool.schedule();
+	throw std::runtime_error("failed on a worker");
+}
+
+// Run many handlers concurrently on a pool with 4 workers
+// Blocking on std::future::get() inside the handlers instead would need a worker per pending handler
+template <class Pool>
+void benchmark(const char* name) {
+	constexpr long long numRequests{10000};
+	Pool pool(4);
+	InFlight inFlight;
+	auto t1 = std::chrono::steady_clock::now();
+	std::vector<CoTask<long long>> handlers;
+	for (long long i = 0; i < numRequests; ++i)
+		handlers.push_back(handleRequest(pool, i, inFlight));
+	auto results = syncWait(whenAll(std::move(handlers)));
+	auto t2 = std::chrono::steady_clock::now();
+	for (long long i = 0; i < numRequests; ++i)
+		assert(results[i] == i * i + (i + 1) * (i + 1));
+	// Handlers suspended in schedule() take turns with the others instead of running to completion one by one
+	assert(inFlight.max > 1);
+	std::cout << name << ": " << numRequests << " handlers in " << std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count()
+		<< "ms, up to " << inFlight.max << " in flight on 4 workers\n";
+
+	// Exceptions thrown on a worker reach the awaiting code
+	try {
+		syncWait(fail(pool));
+		assert(false);
+	}
+	catch (const std::runtime_error& e) {
+		std::cout << name << ": " << e.what() << "\n";
+	}
+}
+
+int main() {
+	benchmark<ThreadPool>("ThreadPool");
+	benchmark<WSThreadPool>("WSThreadPool");
+
+	/* Possible result (single core machine):
+	ThreadPool: 10000 handlers in 12ms, up to 8193 in flight on 4 workers
+	ThreadPool: failed on a worker
+	WSThreadPool: 10000 handlers in 8ms, up to 9298 in flight on 4 workers
+	WSThreadPool: failed on a worker
+	*/
+
+	return 0;
+}
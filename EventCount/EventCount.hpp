@@ -0,0 +1,78 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+// EventCount implemented with std::atomic::wait and std::atomic::notify_one (futex on Linux, WaitOnAddress on Windows)
+// Lets a thread sleep until a condition that lives outside the primitive (e.g. "a queue is not empty") becomes true
+// Notifiers only pay a fence and a load when nobody is waiting
+/* Usage:
+Waiter:
+	auto key = eventCount.prepareWait();
+	if (condition()) eventCount.cancelWait();
+	else eventCount.wait(key);
+Notifier:
+	makeConditionTrue();
+	eventCount.notifyOne();
+*/
+class EventCount
+{
+	std::atomic<uint32_t> m_epoch{ 0 }; // Incremented by every notification that may wake a waiter
+	std::atomic<uint32_t> m_waiters{ 0 }; // Number of threads between prepareWait() and wait()/cancelWait()
+public:
+	EventCount() = default;
+	EventCount(const EventCount&) = delete;
+	EventCount& operator=(const EventCount&) = delete;
+	// Register as a waiter and return the key to pass to wait()
+	// The condition must be re-checked after this call
+	uint32_t prepareWait() {
+		uint32_t key = m_epoch.load(std::memory_order_acquire);
+		m_waiters.fetch_add(1, std::memory_order_seq_cst);
+		// Pairs with the fence in notify(): either the notifier sees this waiter or the waiter sees the condition
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		return key;
+	}
+	// Unregister without sleeping because the condition became true
+	void cancelWait() {
+		m_waiters.fetch_sub(1, std::memory_order_relaxed);
+	}
+	// Sleep until a notification newer than the given key arrives
+	void wait(uint32_t key) {
+		m_epoch.wait(key, std::memory_order_acquire);
+		m_waiters.fetch_sub(1, std::memory_order_relaxed);
+	}
+	// Wake one waiter if there is any
+	void notifyOne() {
+		if (hasWaiters()) {
+			m_epoch.fetch_add(1, std::memory_order_release);
+			m_epoch.notify_one();
+		}
+	}
+	// Wake up to 'count' waiters
+	void notify(size_t count) {
+		if (count == 1)
+			notifyOne();
+		else if (count > 1 && hasWaiters()) {
+			m_epoch.fetch_add(1, std::memory_order_release);
+			size_t waiters = m_waiters.load(std::memory_order_relaxed);
+			for (size_t i = 0; i < count && i < waiters; ++i)
+				m_epoch.notify_one();
+		}
+	}
+	// Wake all waiters
+	void notifyAll() {
+		if (hasWaiters()) {
+			m_epoch.fetch_add(1, std::memory_order_release);
+			m_epoch.notify_all();
+		}
+	}
+	// Approximate number of waiting threads, e.g. the number of parked workers of a pool
+	size_t numWaiters() const {
+		return m_waiters.load(std::memory_order_relaxed);
+	}
+private:
+	bool hasWaiters() {
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		return m_waiters.load(std::memory_order_relaxed) != 0;
+	}
+};
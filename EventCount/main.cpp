@@ -0,0 +1,61 @@
+#include "EventCount.hpp"
+#include <thread>
+#include <vector>
+#include <iostream>
+#include <atomic>
+#include <cassert>
+
+constexpr size_t numConsumers{4};
+constexpr int numItems{100000};
+EventCount eventCount;
+std::atomic<int> available{0}; // Items produced but not consumed yet
+std::atomic<int> consumed{0};
+
+// Take one item if there is any
+bool tryTake() {
+	int count = available.load();
+	while (count > 0) {
+		if (available.compare_exchange_weak(count, count - 1))
+			return true;
+	}
+	return false;
+}
+
+void consume() {
+	while (consumed.load() < numItems) {
+		if (tryTake()) {
+			consumed++;
+			continue;
+		}
+		// Sleep until the producer publishes more items
+		auto key = eventCount.prepareWait();
+		if (available.load() > 0 || consumed.load() >= numItems)
+			eventCount.cancelWait();
+		else
+			eventCount.wait(key);
+	}
+}
+
+int main() {
+	// Launch consumers that sleep while there is nothing to consume
+	std::vector<std::jthread> threads;
+	for (size_t i = 0; i < numConsumers; ++i)
+		threads.emplace_back(consume);
+
+	// Produce items one by one and wake a consumer each time
+	for (int i = 0; i < numItems; ++i) {
+		available++;
+		eventCount.notifyOne();
+	}
+	// Wait for the consumers to finish and wake everyone up so they can exit
+	while (consumed.load() < numItems)
+		std::this_thread::yield();
+	eventCount.notifyAll();
+	for (auto& thread : threads)
+		thread.join();
+
+	assert(consumed.load() == numItems);
+	std::cout << "Consumed " << consumed.load() << " items\n"; // Consumed 100000 items
+
+	return 0;
+}
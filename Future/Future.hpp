@@ -0,0 +1,417 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <variant>
+#include <vector>
+#include <mutex>
+#include <future>
+#include <utility>
+#include <exception>
+#include <type_traits>
+#include <cstdint>
+#include <cassert>
+#include "Task.hpp"
+
+// Lightweight future/promise pair for the thread pools
+// One heap allocation per pair holds the result, an atomic state word, a reference count and one continuation.
+// std::future with std::packaged_task needs a shared state with a mutex and a condition variable instead
+// A future is ready once its state word has the Ready bit. Blocking waits sleep on the state word with std::atomic::wait,
+// and wait(pool) runs pending tasks of the pool instead
+template <class T>
+class Future;
+template <class T>
+class Promise;
+
+namespace detail {
+	// Shared state of a Promise and its Future
+	template <class T>
+	class FutureState
+	{
+	public:
+		using Value = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+		static constexpr uint32_t Ready = 1; // The result is set
+		static constexpr uint32_t HasContinuation = 2; // m_continuation is set and runs when the result is set
+		static constexpr uint32_t HasWaiters = 4; // A thread sleeps in wait()
+	private:
+		std::atomic<uint32_t> m_state{ 0 };
+		std::atomic<uint32_t> m_refs{ 2 }; // One for the Promise, one for the Future
+		std::optional<Value> m_value;
+		std::exception_ptr m_exception;
+		Task m_continuation;
+	public:
+		// Store the result, wake waiters and run the continuation (promise side)
+		template <class... Args>
+		void setValue(Args&&... args) {
+			m_value.emplace(std::forward<Args>(args)...);
+			publish();
+		}
+		void setException(std::exception_ptr exception) {
+			m_exception = std::move(exception);
+			publish();
+		}
+		bool isReady() const { return m_state.load(std::memory_order_acquire) & Ready; }
+		bool hasException() const { return m_exception != nullptr; }
+		// Run 'continuation' on the thread that sets the result, or right away if it is set (future side, at most once)
+		void onReady(Task continuation) {
+			m_continuation = std::move(continuation);
+			if (m_state.fetch_or(HasContinuation, std::memory_order_acq_rel) & Ready)
+				m_continuation();
+		}
+		// Sleep until the result is set
+		void wait() {
+			uint32_t state = m_state.load(std::memory_order_acquire);
+			while (!(state & Ready)) {
+				if (!(state & HasWaiters)) {
+					if (!m_state.compare_exchange_weak(state, state | HasWaiters, std::memory_order_acq_rel))
+						continue;
+					state |= HasWaiters;
+				}
+				m_state.wait(state, std::memory_order_acquire);
+				state = m_state.load(std::memory_order_acquire);
+			}
+		}
+		// Move the result out or rethrow the exception. The result must be set
+		Value take() {
+			if (m_exception)
+				std::rethrow_exception(m_exception);
+			return std::move(*m_value);
+		}
+		std::exception_ptr exception() const { return m_exception; }
+		void release() {
+			if (m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				delete this;
+		}
+	private:
+		void publish() {
+			uint32_t state = m_state.fetch_or(Ready, std::memory_order_acq_rel);
+			assert(!(state & Ready) && "The result of a promise can only be set once");
+			if (state & HasWaiters)
+				m_state.notify_all();
+			if (state & HasContinuation)
+				m_continuation();
+		}
+	};
+
+	// Call func with the result of 'state' and fulfill 'promise' with what it returns or throws
+	template <class T, class U, class Func>
+	void fulfill(FutureState<T>& state, Promise<U>& promise, Func& func) {
+		if (state.hasException()) {
+			promise.setException(state.exception());
+			return;
+		}
+		try {
+			if constexpr (std::is_void_v<T>) {
+				if constexpr (std::is_void_v<U>) {
+					func();
+					promise.setValue();
+				}
+				else
+					promise.setValue(func());
+			}
+			else {
+				if constexpr (std::is_void_v<U>) {
+					func(state.take());
+					promise.setValue();
+				}
+				else
+					promise.setValue(func(state.take()));
+			}
+		}
+		catch (...) {
+			promise.setException(std::current_exception());
+		}
+	}
+
+	template <class T, class Func>
+	struct ThenResult {
+		using type = std::invoke_result_t<Func, T>;
+	};
+	template <class Func>
+	struct ThenResult<void, Func> {
+		using type = std::invoke_result_t<Func>;
+	};
+}
+
+// Producer side. Set the result exactly once
+// Destroying a promise without setting a result stores std::future_error(broken_promise)
+template <class T>
+class Promise
+{
+	detail::FutureState<T>* m_state;
+	bool m_futureRetrieved{ false };
+	bool m_satisfied{ false };
+public:
+	Promise() : m_state(new detail::FutureState<T>()) {}
+	Promise(const Promise&) = delete;
+	Promise& operator=(const Promise&) = delete;
+	Promise(Promise&& other) noexcept
+		: m_state(std::exchange(other.m_state, nullptr)), m_futureRetrieved(other.m_futureRetrieved), m_satisfied(other.m_satisfied) {}
+	Promise& operator=(Promise&& other) noexcept {
+		if (this != &other) {
+			abandon();
+			m_state = std::exchange(other.m_state, nullptr);
+			m_futureRetrieved = other.m_futureRetrieved;
+			m_satisfied = other.m_satisfied;
+		}
+		return *this;
+	}
+	~Promise() { abandon(); }
+	// Get the future of this promise. Call it at most once
+	Future<T> getFuture() {
+		assert(!m_futureRetrieved);
+		m_futureRetrieved = true;
+		return Future<T>(m_state);
+	}
+	template <class... Args>
+	void setValue(Args&&... args) {
+		m_satisfied = true;
+		m_state->setValue(std::forward<Args>(args)...);
+	}
+	void setException(std::exception_ptr exception) {
+		m_satisfied = true;
+		m_state->setException(std::move(exception));
+	}
+private:
+	void abandon() {
+		if (!m_state)
+			return;
+		if (!m_satisfied)
+			m_state->setException(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+		// The future's reference is dropped here too if it was never retrieved
+		if (!m_futureRetrieved)
+			m_state->release();
+		m_state->release();
+		m_state = nullptr;
+	}
+};
+
+// Consumer side. get() and then() consume the future
+template <class T>
+class Future
+{
+	friend class Promise<T>;
+	detail::FutureState<T>* m_state{ nullptr };
+	explicit Future(detail::FutureState<T>* state) : m_state(state) {}
+public:
+	Future() = default;
+	Future(const Future&) = delete;
+	Future& operator=(const Future&) = delete;
+	Future(Future&& other) noexcept : m_state(std::exchange(other.m_state, nullptr)) {}
+	Future& operator=(Future&& other) noexcept {
+		if (this != &other) {
+			if (m_state)
+				m_state->release();
+			m_state = std::exchange(other.m_state, nullptr);
+		}
+		return *this;
+	}
+	~Future() {
+		if (m_state)
+			m_state->release();
+	}
+	// Check if the future refers to a shared state
+	bool valid() const { return m_state != nullptr; }
+	bool isReady() const { return m_state->isReady(); }
+	// Sleep until the result is set
+	void wait() const { m_state->wait(); }
+	// Run pending tasks of the pool until the result is set
+	// Use it on a worker of the pool to wait for a task that may still be queued
+	template <class Pool>
+	void wait(Pool& pool) const {
+		while (!m_state->isReady())
+			pool.runPendingTask();
+	}
+	// Wait for the result and move it out. Rethrows the exception set by the producer
+	T get() {
+		wait();
+		auto state = std::exchange(m_state, nullptr);
+		struct Release {
+			detail::FutureState<T>* state;
+			~Release() { state->release(); }
+		} release{ state };
+		if constexpr (std::is_void_v<T>)
+			state->take();
+		else
+			return state->take();
+	}
+	// Run func with the result on the pool once the result is set and return a future for what func returns
+	// func takes the result by value (no argument if T is void). An exception skips func and is passed on
+	template <class Pool, class Func>
+	Future<typename detail::ThenResult<T, Func>::type> then(Pool& pool, Func func);
+	// Call onReady(state) on the thread that sets the result. Used by the combinators
+	template <class Func>
+	void onReady(Func func) {
+		auto state = std::exchange(m_state, nullptr);
+		state->onReady(Task([state, func = std::move(func)]() mutable {
+			func(*state);
+			state->release();
+		}));
+	}
+};
+
+template <class T>
+template <class Pool, class Func>
+Future<typename detail::ThenResult<T, Func>::type> Future<T>::then(Pool& pool, Func func) {
+	using ResultType = typename detail::ThenResult<T, Func>::type;
+	Promise<ResultType> promise;
+	auto result = promise.getFuture();
+	auto state = std::exchange(m_state, nullptr);
+	state->onReady(Task([&pool, state, promise = std::move(promise), func = std::move(func)]() mutable {
+		pool.post([state, promise = std::move(promise), func = std::move(func)]() mutable {
+			detail::fulfill(*state, promise, func);
+			state->release();
+		});
+	}));
+	return result;
+}
+
+// Run func on the pool and return a future for its result
+template <class Pool, class Func>
+Future<std::invoke_result_t<Func>> spawn(Pool& pool, Func func) {
+	using ResultType = std::invoke_result_t<Func>;
+	Promise<ResultType> promise;
+	auto future = promise.getFuture();
+	pool.post([promise = std::move(promise), func = std::move(func)]() mutable {
+		try {
+			if constexpr (std::is_void_v<ResultType>) {
+				func();
+				promise.setValue();
+			}
+			else
+				promise.setValue(func());
+		}
+		catch (...) {
+			promise.setException(std::current_exception());
+		}
+	});
+	return future;
+}
+
+// Future that is ready when all futures are ready, with their results in order
+// If any of them failed, it holds the exception of the first failed future in order
+template <class T>
+Future<std::vector<T>> whenAll(std::vector<Future<T>> futures) {
+	struct Shared {
+		std::vector<std::optional<T>> results;
+		std::vector<std::exception_ptr> exceptions;
+		std::atomic<size_t> remaining;
+		Promise<std::vector<T>> promise;
+		explicit Shared(size_t count) : results(count), exceptions(count), remaining(count) {}
+	};
+	auto shared = std::make_shared<Shared>(futures.size());
+	auto result = shared->promise.getFuture();
+	auto finish = [](Shared& shared) {
+		for (auto& exception : shared.exceptions) {
+			if (exception) {
+				shared.promise.setException(exception);
+				return;
+			}
+		}
+		std::vector<T> values;
+		values.reserve(shared.results.size());
+		for (auto& value : shared.results)
+			values.push_back(std::move(*value));
+		shared.promise.setValue(std::move(values));
+	};
+	if (futures.empty())
+		finish(*shared);
+	for (size_t i = 0; i < futures.size(); ++i) {
+		futures[i].onReady([shared, i, finish](detail::FutureState<T>& state) {
+			if (state.hasException())
+				shared->exceptions[i] = state.exception();
+			else
+				shared->results[i].emplace(state.take());
+			if (shared->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				finish(*shared);
+		});
+	}
+	return result;
+}
+
+// Future that is ready when all futures are ready
+// If any of them failed, it holds the exception of the first failed future in order
+inline Future<void> whenAll(std::vector<Future<void>> futures) {
+	struct Shared {
+		std::vector<std::exception_ptr> exceptions;
+		std::atomic<size_t> remaining;
+		Promise<void> promise;
+		explicit Shared(size_t count) : exceptions(count), remaining(count) {}
+	};
+	auto shared = std::make_shared<Shared>(futures.size());
+	auto result = shared->promise.getFuture();
+	auto finish = [](Shared& shared) {
+		for (auto& exception : shared.exceptions) {
+			if (exception) {
+				shared.promise.setException(exception);
+				return;
+			}
+		}
+		shared.promise.setValue();
+	};
+	if (futures.empty())
+		finish(*shared);
+	for (size_t i = 0; i < futures.size(); ++i) {
+		futures[i].onReady([shared, i, finish](detail::FutureState<void>& state) {
+			if (state.hasException())
+				shared->exceptions[i] = state.exception();
+			if (shared->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				finish(*shared);
+		});
+	}
+	return result;
+}
+
+// Result of whenAny(): the index of the first ready future and its result
+template <class T>
+struct WhenAnyResult {
+	size_t index;
+	T value;
+};
+
+// Future that is ready when the first of the futures is ready, with its index and result or exception
+// The results of the other futures are discarded. 'futures' must not be empty
+template <class T>
+Future<WhenAnyResult<T>> whenAny(std::vector<Future<T>> futures) {
+	assert(!futures.empty());
+	struct Shared {
+		std::atomic<bool> done{ false };
+		Promise<WhenAnyResult<T>> promise;
+	};
+	auto shared = std::make_shared<Shared>();
+	auto result = shared->promise.getFuture();
+	for (size_t i = 0; i < futures.size(); ++i) {
+		futures[i].onReady([shared, i](detail::FutureState<T>& state) {
+			if (shared->done.exchange(true, std::memory_order_acq_rel))
+				return;
+			if (state.hasException())
+				shared->promise.setException(state.exception());
+			else
+				shared->promise.setValue(WhenAnyResult<T>{ i, state.take() });
+		});
+	}
+	return result;
+}
+
+// Future that is ready when the first of the futures is ready, with its index or exception
+// 'futures' must not be empty
+inline Future<size_t> whenAny(std::vector<Future<void>> futures) {
+	assert(!futures.empty());
+	struct Shared {
+		std::atomic<bool> done{ false };
+		Promise<size_t> promise;
+	};
+	auto shared = std::make_shared<Shared>();
+	auto result = shared->promise.getFuture();
+	for (size_t i = 0; i < futures.size(); ++i) {
+		futures[i].onReady([shared, i](detail::FutureState<void>& state) {
+			if (shared->done.exchange(true, std::memory_order_acq_rel))
+				return;
+			if (state.hasException())
+				shared->promise.setException(state.exception());
+			else
+				shared->promise.setValue(i);
+		});
+	}
+	return result;
+}
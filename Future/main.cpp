@@ -0,0 +1,108 @@
+#include "Future.hpp"
+#include "ThreadPool.hpp"
+#include "WSThreadPool.hpp"
+#include "AllocationCounter.hpp"
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <stdexcept>
+#include <cassert>
+
+// Submit small tasks and wait for each result, with std::future and with Future
+template <class Pool>
+void benchmarkSubmitGet(const char* name) {
+	constexpr int numTasks{100000};
+	Pool pool(4);
+	long long sum = 0;
+
+	auto before = allocations.load();
+	auto t1 = std::chrono::steady_clock::now();
+	std::vector<std::future<int>> stdFutures;
+	stdFutures.reserve(numTasks);
+	for (int i = 0; i < numTasks; ++i)
+		stdFutures.emplace_back(pool.submit([i]() { return i; }));
+	for (auto& future : stdFutures)
+		sum += future.get();
+	auto t2 = std::chrono::steady_clock::now();
+	auto stdAllocations = allocations.load() - before;
+
+	before = allocations.load();
+	auto t3 = std::chrono::steady_clock::now();
+	std::vector<Future<int>> futures;
+	futures.reserve(numTasks);
+	for (int i = 0; i < numTasks; ++i)
+		futures.emplace_back(spawn(pool, [i]() { return i; }));
+	for (auto& future : futures)
+		sum -= future.get();
+	auto t4 = std::chrono::steady_clock::now();
+	auto allocationsAfter = allocations.load() - before;
+
+	assert(sum == 0);
+	std::cout << name << ": std::future " << std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count() << "ms, "
+		<< static_cast<double>(stdAllocations) / numTasks << " allocations per task / Future "
+		<< std::chrono::duration_cast<std::chrono::milliseconds>(t4 - t3).count() << "ms, "
+		<< static_cast<double>(allocationsAfter) / numTasks << " allocations per task\n";
+}
+
+int main() {
+	benchmarkSubmitGet<ThreadPool>("ThreadPool");
+	benchmarkSubmitGet<WSThreadPool>("WSThreadPool");
+
+	WSThreadPool pool(4);
+
+	// Continuations run on the pool when the result is set
+	auto length = spawn(pool, []() { return std::string("continuation"); })
+		.then(pool, [](std::string text) { return text.size(); })
+		.then(pool, [](size_t size) { return static_cast<int>(size) * 2; });
+	[[maybe_unused]] int doubled = length.get();
+	assert(doubled == 24);
+
+	// Exceptions skip the continuations and reach get()
+	auto failed = spawn(pool, []() -> int { throw std::runtime_error("failed on a worker"); })
+		.then(pool, [](int value) { return value + 1; });
+	try {
+		failed.get();
+		assert(false);
+	}
+	catch (const std::runtime_error& e) {
+		std::cout << e.what() << "\n";
+	}
+
+	// whenAll collects the results in order
+	std::vector<Future<int>> squares;
+	for (int i = 0; i < 100; ++i)
+		squares.push_back(spawn(pool, [i]() { return i * i; }));
+	auto all = whenAll(std::move(squares)).get();
+	for (int i = 0; i < 100; ++i)
+		assert(all[i] == i * i);
+
+	// whenAny is ready with the first result
+	Promise<int> never;
+	std::vector<Future<int>> racing;
+	racing.push_back(never.getFuture());
+	racing.push_back(spawn(pool, []() { return 42; }));
+	[[maybe_unused]] auto first = whenAny(std::move(racing)).get();
+	assert(first.index == 1 && first.value == 42);
+
+	// A worker waiting for a task it spawned runs pending tasks instead of blocking
+	auto outer = spawn(pool, [&pool]() {
+		std::vector<Future<void>> inner;
+		for (int i = 0; i < 16; ++i)
+			inner.push_back(spawn(pool, []() { std::this_thread::sleep_for(std::chrono::microseconds(100)); }));
+		auto done = whenAll(std::move(inner));
+		done.wait(pool);
+		done.get();
+		return true;
+	});
+	[[maybe_unused]] bool outerDone = outer.get();
+	assert(outerDone);
+
+	/* Possible result (single core machine):
+	ThreadPool: std::future 72ms, 2.00013 allocations per task / Future 38ms, 1.00001 allocations per task
+	WSThreadPool: std::future 61ms, 2.00013 allocations per task / Future 27ms, 1.00002 allocations per task
+	failed on a worker
+	*/
+
+	return 0;
+}
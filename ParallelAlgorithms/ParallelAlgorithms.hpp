@@ -0,0 +1,205 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <numeric>
+#include <concepts>
+#include "WSThreadPool.hpp"
+
+// Parallel algorithms on a WSThreadPool
+// Ranges are split lazily (lazy binary splitting): a task processes its range 'grain' items at a time
+// and only splits off the upper half when its worker's own queue is empty, i.e. when idle workers
+// would otherwise have nothing to steal. The split depth adapts to the load, so there is no chunk size to tune
+// 'grain' is the smallest amount of work done between two split checks. 0 picks one from the range size
+// Every function blocks until the whole range is processed. A worker of the pool runs other tasks while it waits
+// The callables must not throw
+namespace detail {
+	// Number of unfinished tasks of one algorithm call
+	// Shared by the tasks so that the last one can notify the caller after the caller's stack frame is gone
+	struct Join {
+		std::atomic<size_t> pending{ 1 };
+		void finish() {
+			if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				pending.notify_all();
+		}
+	};
+
+	// Grain that leaves about 64 chunks per thread if no split happens
+	inline size_t defaultGrain(const WSThreadPool& pool, size_t size) {
+		return std::max<size_t>(1, size / (std::max<size_t>(pool.getNumThreads(), 1) * 64));
+	}
+
+	// What one task does with its part of the range: part(begin, end) processes a chunk,
+	// and part.split() returns the part for an upper half that the task splits off
+	// Parts that need no per-task state share one body
+	template <class Body>
+	struct SharedBody {
+		Body* body;
+		void operator()(size_t begin, size_t end) { (*body)(begin, end); }
+		SharedBody split() const { return *this; }
+	};
+
+	// Call part(begin, end) on consecutive chunks of [begin, end), splitting off halves on demand
+	// The task's own chunks are processed in order and cover the lower end of the range. Each split takes the upper half of what is left
+	template <class Part>
+	void splitRange(WSThreadPool& pool, const std::shared_ptr<Join>& join, size_t begin, size_t end, size_t grain, Part part) {
+		while (end - begin > grain) {
+			if (pool.localQueueSize() == 0) {
+				size_t mid = begin + (end - begin) / 2;
+				join->pending.fetch_add(1, std::memory_order_relaxed);
+				pool.post([&pool, join, mid, end, grain, half = part.split()]() {
+					splitRange(pool, join, mid, end, grain, half);
+					join->finish();
+				});
+				end = mid;
+			}
+			else {
+				part(begin, begin + grain);
+				begin += grain;
+			}
+		}
+		part(begin, end);
+	}
+
+	// Run part over [0, size) on the pool and wait for it
+	template <class Part>
+	void runRange(WSThreadPool& pool, size_t size, size_t grain, Part part) {
+		if (size == 0)
+			return;
+		if (grain == 0)
+			grain = defaultGrain(pool, size);
+		auto join = std::make_shared<Join>();
+		if (pool.isWorkerThread()) {
+			// Start on the calling worker and help until the stolen halves are done
+			splitRange(pool, join, 0, size, grain, part);
+			join->finish();
+			while (join->pending.load(std::memory_order_acquire) != 0)
+				pool.runPendingTask();
+		}
+		else {
+			pool.post([&pool, join, size, grain, part]() {
+				splitRange(pool, join, 0, size, grain, part);
+				join->finish();
+			});
+			size_t pending;
+			while ((pending = join->pending.load(std::memory_order_acquire)) != 0)
+				join->pending.wait(pending, std::memory_order_acquire);
+		}
+	}
+
+	// Advance a random access iterator by an unsigned offset
+	template <std::random_access_iterator It>
+	It advance(It it, size_t offset) {
+		return it + static_cast<std::iter_difference_t<It>>(offset);
+	}
+
+	// Node of the reduction tree of parallelReduce, one per task
+	// 'value' combines the chunks the task processed itself, which lie below the halves it split off
+	// Each split takes the upper half of what was left, so 'splits' holds the halves from right to left
+	template <class T>
+	struct ReduceNode {
+		std::optional<T> value;
+		std::vector<std::unique_ptr<ReduceNode>> splits;
+	};
+
+	// Part of parallelReduce. Only the task that owns a node writes it, and the caller reads the tree after the join
+	template <class It, class T, class BinaryOp>
+	struct ReducePart {
+		It first;
+		BinaryOp* op;
+		ReduceNode<T>* node;
+		void operator()(size_t begin, size_t end) {
+			size_t i = begin;
+			if (!node->value)
+				node->value.emplace(*advance(first, i++));
+			for (; i < end; ++i)
+				*node->value = (*op)(std::move(*node->value), *advance(first, i));
+		}
+		ReducePart split() const {
+			node->splits.push_back(std::make_unique<ReduceNode<T>>());
+			return { first, op, node->splits.back().get() };
+		}
+	};
+
+	// Combine 'acc' with the partials of a subtree from left to right
+	template <class T, class BinaryOp>
+	T combineTree(ReduceNode<T>& node, T acc, BinaryOp& op) {
+		if (node.value)
+			acc = op(std::move(acc), std::move(*node.value));
+		for (auto split = node.splits.rbegin(); split != node.splits.rend(); ++split)
+			acc = combineTree(**split, std::move(acc), op);
+		return acc;
+	}
+}
+
+// Call body(i) for every i in [first, last)
+template <std::integral Index, class Func>
+void parallelFor(WSThreadPool& pool, Index first, Index last, Func body, size_t grain = 0) {
+	if (!(first < last))
+		return;
+	auto chunk = [first, &body](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+			body(static_cast<Index>(first + static_cast<Index>(i)));
+	};
+	detail::runRange(pool, static_cast<size_t>(last - first), grain, detail::SharedBody<decltype(chunk)>{ &chunk });
+}
+
+// Write op(x) for every x in [first, last) to the range starting at 'out'
+// Returns the end of the output range
+template <std::random_access_iterator InputIt, std::random_access_iterator OutputIt, class UnaryOp>
+OutputIt parallelTransform(WSThreadPool& pool, InputIt first, InputIt last, OutputIt out, UnaryOp op, size_t grain = 0) {
+	size_t size = static_cast<size_t>(last - first);
+	auto chunk = [first, out, &op](size_t begin, size_t end) {
+		std::transform(detail::advance(first, begin), detail::advance(first, end), detail::advance(out, begin), op);
+	};
+	detail::runRange(pool, size, grain, detail::SharedBody<decltype(chunk)>{ &chunk });
+	return detail::advance(out, size);
+}
+
+// Combine init and every element of [first, last) with op
+// Every task reduces its own chunks into its node of a tree that follows the splits, with no shared lock,
+// and the caller combines the nodes from left to right once all tasks are done
+// op must be associative. Unlike std::reduce, it need not be commutative: the operands keep their order
+// The grouping follows the splits, which depend on the load, so a floating-point sum may still round differently from run to run
+template <std::random_access_iterator It, class T, class BinaryOp>
+T parallelReduce(WSThreadPool& pool, It first, It last, T init, BinaryOp op, size_t grain = 0) {
+	detail::ReduceNode<T> root;
+	detail::runRange(pool, static_cast<size_t>(last - first), grain, detail::ReducePart<It, T, BinaryOp>{ first, &op, &root });
+	return detail::combineTree(root, std::move(init), op);
+}
+
+// Write the inclusive prefix combinations of [first, last) under op to the range starting at 'out'
+// 'out' may equal 'first'. op must be associative
+// Blocks are scanned in parallel, then every block except the first is offset by the combination of the blocks before it
+// Returns the end of the output range
+template <std::random_access_iterator InputIt, std::random_access_iterator OutputIt, class BinaryOp>
+OutputIt parallelInclusiveScan(WSThreadPool& pool, InputIt first, InputIt last, OutputIt out, BinaryOp op) {
+	using T = std::iter_value_t<InputIt>;
+	size_t size = static_cast<size_t>(last - first);
+	// A few blocks per thread so that a slow thread does not hold up the whole pass
+	size_t numBlocks = std::min(size, std::max<size_t>(pool.getNumThreads(), 1) * 8);
+	if (numBlocks < 2)
+		return std::inclusive_scan(first, last, out, op);
+	auto blockBegin = [size, numBlocks](size_t block) { return size * block / numBlocks; };
+	// Scan every block on its own
+	parallelFor(pool, size_t{ 0 }, numBlocks, [&](size_t block) {
+		std::inclusive_scan(detail::advance(first, blockBegin(block)), detail::advance(first, blockBegin(block + 1)),
+			detail::advance(out, blockBegin(block)), op);
+	}, 1);
+	// Combination of all blocks before each block, starting with block 1
+	std::vector<T> offsets;
+	offsets.reserve(numBlocks - 1);
+	offsets.push_back(*detail::advance(out, blockBegin(1) - 1));
+	for (size_t block = 1; block + 1 < numBlocks; ++block)
+		offsets.push_back(op(offsets.back(), *detail::advance(out, blockBegin(block + 1) - 1)));
+	// Apply the offsets
+	parallelFor(pool, size_t{ 1 }, numBlocks, [&](size_t block) {
+		const T& offset = offsets[block - 1];
+		std::for_each(detail::advance(out, blockBegin(block)), detail::advance(out, blockBegin(block + 1)),
+			[&](auto& value) { value = op(offset, value); });
+	}, 1);
+	return detail::advance(out, size);
+}
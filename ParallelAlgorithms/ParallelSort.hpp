@@ -0,0 +1,190 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <concepts>
+#include <cstdint>
+#include <climits>
+#include "ParallelAlgorithms.hpp"
+
+// Parallel sorts on a WSThreadPool
+// Both move the elements through a buffer as large as the input,
+// so the value type must be default constructible and move assignable
+namespace detail {
+	// Inputs smaller than this are sorted sequentially
+	constexpr size_t sequentialSortThreshold{ 1 << 14 };
+
+	// Number of blocks the input is cut into for the counting and scattering passes
+	inline size_t numSortBlocks(const WSThreadPool& pool, size_t size) {
+		return std::clamp<size_t>(size / 4096, 1, std::max<size_t>(pool.getNumThreads(), 1) * 4);
+	}
+
+	// One LSD radix pass on the 8 bits of the key starting at 'shift'. Moves [source, source + size) to dest
+	// 'counts' holds a histogram row per block
+	// Returns false without moving anything if all keys have the same digit
+	template <class Source, class Dest, class DigitKey>
+	bool radixPass(WSThreadPool& pool, Source source, Dest dest, size_t size, unsigned shift, DigitKey& digitKey,
+		std::vector<size_t>& counts, size_t numBlocks) {
+		constexpr size_t radix{ 256 };
+		auto blockBegin = [size, numBlocks](size_t block) { return size * block / numBlocks; };
+		auto digit = [&digitKey, shift](const auto& value) { return static_cast<size_t>((digitKey(value) >> shift) & (radix - 1)); };
+		// Histogram of each block
+		std::fill(counts.begin(), counts.end(), 0);
+		parallelFor(pool, size_t{ 0 }, numBlocks, [&](size_t block) {
+			size_t* row = &counts[block * radix];
+			for (size_t i = blockBegin(block); i < blockBegin(block + 1); ++i)
+				++row[digit(*detail::advance(source, i))];
+		}, 1);
+		// Turn the counts into the position of each block's first element with each digit
+		size_t sum = 0, usedDigits = 0;
+		for (size_t d = 0; d < radix; ++d) {
+			size_t before = sum;
+			for (size_t block = 0; block < numBlocks; ++block) {
+				size_t count = counts[block * radix + d];
+				counts[block * radix + d] = sum;
+				sum += count;
+			}
+			usedDigits += sum != before;
+		}
+		if (usedDigits == 1)
+			return false;
+		// Scatter. Every block writes to its own positions, so the order within a digit is kept (stable)
+		parallelFor(pool, size_t{ 0 }, numBlocks, [&](size_t block) {
+			size_t* row = &counts[block * radix];
+			for (size_t i = blockBegin(block); i < blockBegin(block + 1); ++i) {
+				auto& value = *detail::advance(source, i);
+				*detail::advance(dest, row[digit(value)]++) = std::move(value);
+			}
+		}, 1);
+		return true;
+	}
+}
+
+// Sort [first, last) with comp using a parallel samplesort
+// 1. Splitters are picked from a sorted random sample of the input
+// 2. Blocks of the input are classified into buckets between and equal to the splitters in parallel
+// 3. Elements are scattered into the buffer bucket by bucket, in parallel by block
+// 4. Buckets are sorted in parallel. Buckets of elements equal to a splitter need no sorting,
+//    so inputs with few unique values do not degrade
+// Not stable. Small inputs and pools with fewer than 2 threads use std::sort
+template <std::random_access_iterator It, class Compare = std::less<>>
+void parallelSort(WSThreadPool& pool, It first, It last, Compare comp = {}) {
+	using T = std::iter_value_t<It>;
+	size_t size = static_cast<size_t>(last - first);
+	size_t numThreads = pool.getNumThreads();
+	if (size < detail::sequentialSortThreshold || numThreads < 2) {
+		std::sort(first, last, comp);
+		return;
+	}
+
+	// Pick splitters from an oversampled random sample
+	constexpr size_t oversampling{ 16 };
+	size_t numSplitters = numThreads * 8 - 1;
+	std::vector<T> splitters;
+	{
+		std::vector<T> sample;
+		sample.reserve((numSplitters + 1) * oversampling);
+		uint64_t state = size | 1;
+		for (size_t i = 0; i < (numSplitters + 1) * oversampling; ++i) {
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			sample.push_back(*detail::advance(first, state % size));
+		}
+		std::sort(sample.begin(), sample.end(), comp);
+		for (size_t i = 1; i <= numSplitters; ++i)
+			splitters.push_back(sample[i * oversampling]);
+		// Equal splitters would only produce empty buckets
+		splitters.erase(std::unique(splitters.begin(), splitters.end(), [&](const T& a, const T& b) { return !comp(a, b); }), splitters.end());
+	}
+	// Bucket 2i holds the elements between splitter i - 1 and splitter i, bucket 2i + 1 the elements equal to splitter i
+	size_t numBuckets = 2 * splitters.size() + 1;
+	auto classify = [&](const T& value) {
+		auto it = std::lower_bound(splitters.begin(), splitters.end(), value, comp);
+		size_t index = static_cast<size_t>(it - splitters.begin());
+		return static_cast<uint32_t>((it != splitters.end() && !comp(value, *it)) ? 2 * index + 1 : 2 * index);
+	};
+
+	// Classify every block and count its elements per bucket
+	size_t numBlocks = detail::numSortBlocks(pool, size);
+	auto blockBegin = [size, numBlocks](size_t block) { return size * block / numBlocks; };
+	std::vector<uint32_t> bucketOf(size);
+	std::vector<size_t> counts(numBlocks * numBuckets);
+	parallelFor(pool, size_t{ 0 }, numBlocks, [&](size_t block) {
+		size_t* row = &counts[block * numBuckets];
+		for (size_t i = blockBegin(block); i < blockBegin(block + 1); ++i) {
+			bucketOf[i] = classify(*detail::advance(first, i));
+			++row[bucketOf[i]];
+		}
+	}, 1);
+	// Position of each block's first element in each bucket
+	std::vector<size_t> bucketBegin(numBuckets + 1);
+	size_t sum = 0;
+	for (size_t bucket = 0; bucket < numBuckets; ++bucket) {
+		bucketBegin[bucket] = sum;
+		for (size_t block = 0; block < numBlocks; ++block) {
+			size_t count = counts[block * numBuckets + bucket];
+			counts[block * numBuckets + bucket] = sum;
+			sum += count;
+		}
+	}
+	bucketBegin[numBuckets] = sum;
+
+	// Scatter into the buffer
+	std::vector<T> buffer(size);
+	parallelFor(pool, size_t{ 0 }, numBlocks, [&](size_t block) {
+		size_t* row = &counts[block * numBuckets];
+		for (size_t i = blockBegin(block); i < blockBegin(block + 1); ++i)
+			buffer[row[bucketOf[i]]++] = std::move(*detail::advance(first, i));
+	}, 1);
+
+	// Sort the buckets and move them back
+	parallelFor(pool, size_t{ 0 }, numBuckets, [&](size_t bucket) {
+		auto begin = buffer.begin() + static_cast<std::ptrdiff_t>(bucketBegin[bucket]);
+		auto end = buffer.begin() + static_cast<std::ptrdiff_t>(bucketBegin[bucket + 1]);
+		if (bucket % 2 == 0)
+			std::sort(begin, end, comp);
+		std::move(begin, end, detail::advance(first, bucketBegin[bucket]));
+	}, 1);
+}
+
+// Sort [first, last) by an integer key with a parallel LSD radix sort (8 bits per pass)
+// 'key' maps an element to an integral key. Signed keys are ordered correctly
+// Passes in which every key has the same digit are skipped, e.g. the upper bytes of small keys
+// Stable. Small inputs use std::stable_sort
+template <std::random_access_iterator It, class KeyFunc = std::identity>
+	requires std::integral<std::remove_cvref_t<std::invoke_result_t<KeyFunc&, const std::iter_value_t<It>&>>>
+void parallelRadixSort(WSThreadPool& pool, It first, It last, KeyFunc key = {}) {
+	using T = std::iter_value_t<It>;
+	using Key = std::remove_cvref_t<std::invoke_result_t<KeyFunc&, const T&>>;
+	using UnsignedKey = std::make_unsigned_t<Key>;
+	constexpr unsigned keyBits = sizeof(UnsignedKey) * CHAR_BIT;
+	size_t size = static_cast<size_t>(last - first);
+	if (size < detail::sequentialSortThreshold) {
+		std::stable_sort(first, last, [&key](const T& a, const T& b) { return std::invoke(key, a) < std::invoke(key, b); });
+		return;
+	}
+	// Flipping the sign bit orders signed keys correctly as unsigned numbers
+	auto digitKey = [&key](const T& value) {
+		UnsignedKey result = static_cast<UnsignedKey>(std::invoke(key, value));
+		if constexpr (std::is_signed_v<Key>)
+			result ^= UnsignedKey{ 1 } << (keyBits - 1);
+		return result;
+	};
+
+	size_t numBlocks = detail::numSortBlocks(pool, size);
+	std::vector<size_t> counts(numBlocks * 256);
+	std::vector<T> buffer(size);
+	bool inBuffer = false;
+	for (unsigned shift = 0; shift < keyBits; shift += 8) {
+		bool moved = inBuffer
+			? detail::radixPass(pool, buffer.begin(), first, size, shift, digitKey, counts, numBlocks)
+			: detail::radixPass(pool, first, buffer.begin(), size, shift, digitKey, counts, numBlocks);
+		if (moved)
+			inBuffer = !inBuffer;
+	}
+	if (inBuffer)
+		parallelFor(pool, size_t{ 0 }, size, [&](size_t i) { *detail::advance(first, i) = std::move(buffer[i]); });
+}
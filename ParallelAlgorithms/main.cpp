@@ -0,0 +1,150 @@
+#include "ParallelAlgorithms.hpp"
+#include "ParallelSort.hpp"
+#include <iostream>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <execution>
+#include <chrono>
+#include <cmath>
+#include <cassert>
+#include <cstdint>
+#include <random>
+#include <string>
+
+WSThreadPool pool;
+constexpr size_t numElements{ 10000000 };
+
+// Run func and return the elapsed time in milliseconds
+template <class Func>
+long long measureMs(Func func) {
+	auto start = std::chrono::steady_clock::now();
+	func();
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void printRow(const char* name, long long sequential, long long stdParallel, long long pool) {
+	std::cout << name << ": sequential " << sequential << "ms, std::execution::par " << stdParallel << "ms, WSThreadPool " << pool << "ms\n";
+}
+
+// Sort copies of 'data' with every sort and check that the results agree
+void benchmarkSort(const char* name, const std::vector<uint32_t>& data) {
+	auto expected = data, stdParallel = data, sample = data, radix = data;
+	auto sequentialMs = measureMs([&]() { std::sort(expected.begin(), expected.end()); });
+	auto stdParallelMs = measureMs([&]() { std::sort(std::execution::par, stdParallel.begin(), stdParallel.end()); });
+	auto sampleMs = measureMs([&]() { parallelSort(pool, sample.begin(), sample.end()); });
+	auto radixMs = measureMs([&]() { parallelRadixSort(pool, radix.begin(), radix.end()); });
+	assert(stdParallel == expected && sample == expected && radix == expected);
+	std::cout << name << ": std::sort " << sequentialMs << "ms, std::execution::par " << stdParallelMs
+		<< "ms, samplesort " << sampleMs << "ms, radix sort " << radixMs << "ms\n";
+}
+
+int main() {
+	std::vector<uint64_t> input(numElements);
+	std::iota(input.begin(), input.end(), 0);
+	std::vector<uint64_t> expected(numElements), result(numElements);
+
+	// parallelFor with a body that is more expensive than a memory access
+	std::vector<double> roots(numElements), expectedRoots(numElements);
+	auto forSequential = measureMs([&]() {
+		std::for_each(input.begin(), input.end(), [&](uint64_t i) { expectedRoots[i] = std::sqrt(static_cast<double>(i)) * std::log1p(static_cast<double>(i)); });
+	});
+	auto forStd = measureMs([&]() {
+		std::for_each(std::execution::par, input.begin(), input.end(), [&](uint64_t i) { roots[i] = std::sqrt(static_cast<double>(i)) * std::log1p(static_cast<double>(i)); });
+	});
+	auto forPool = measureMs([&]() {
+		parallelFor(pool, size_t{ 0 }, numElements, [&](size_t i) { roots[i] = std::sqrt(static_cast<double>(i)) * std::log1p(static_cast<double>(i)); });
+	});
+	assert(roots == expectedRoots);
+	printRow("for", forSequential, forStd, forPool);
+
+	// parallelTransform
+	auto twice = [](uint64_t x) { return 2 * x + 1; };
+	auto transformSequential = measureMs([&]() { std::transform(input.begin(), input.end(), expected.begin(), twice); });
+	auto transformStd = measureMs([&]() { std::transform(std::execution::par, input.begin(), input.end(), result.begin(), twice); });
+	auto transformPool = measureMs([&]() { parallelTransform(pool, input.begin(), input.end(), result.begin(), twice); });
+	assert(result == expected);
+	printRow("transform", transformSequential, transformStd, transformPool);
+
+	// parallelReduce
+	uint64_t sumSequential{}, sumStd{}, sumPool{};
+	auto reduceSequential = measureMs([&]() { sumSequential = std::reduce(input.begin(), input.end(), uint64_t{ 0 }); });
+	auto reduceStd = measureMs([&]() { sumStd = std::reduce(std::execution::par, input.begin(), input.end(), uint64_t{ 0 }); });
+	auto reducePool = measureMs([&]() { sumPool = parallelReduce(pool, input.begin(), input.end(), uint64_t{ 0 }, std::plus<>{}); });
+	assert(sumStd == sumSequential && sumPool == sumSequential);
+	printRow("reduce", reduceSequential, reduceStd, reducePool);
+
+	// parallelInclusiveScan
+	auto scanSequential = measureMs([&]() { std::inclusive_scan(input.begin(), input.end(), expected.begin()); });
+	auto scanStd = measureMs([&]() { std::inclusive_scan(std::execution::par, input.begin(), input.end(), result.begin()); });
+	assert(result == expected);
+	auto scanPool = measureMs([&]() { parallelInclusiveScan(pool, input.begin(), input.end(), result.begin(), std::plus<>{}); });
+	assert(result == expected);
+	printRow("inclusive scan", scanSequential, scanStd, scanPool);
+
+	// Empty and tiny ranges
+	[[maybe_unused]] uint64_t tiny = parallelReduce(pool, input.begin(), input.begin(), uint64_t{ 7 }, std::plus<>{});
+	assert(tiny == 7);
+	tiny = parallelReduce(pool, input.begin() + 5, input.begin() + 6, uint64_t{ 0 }, std::plus<>{});
+	assert(tiny == 5);
+	parallelInclusiveScan(pool, input.begin(), input.begin() + 3, result.begin(), std::plus<>{});
+	assert(result[0] == 0 && result[1] == 1 && result[2] == 3);
+
+	// A non-commutative op on 4 workers. The partials are combined in the order of the range, however it was split and stolen
+	WSThreadPool wide(4);
+	std::vector<std::string> letters(100000);
+	std::string expectedWord;
+	for (size_t i = 0; i < letters.size(); ++i) {
+		letters[i] = static_cast<char>('a' + i % 26);
+		expectedWord += letters[i];
+	}
+	for (int run = 0; run < 10; ++run) {
+		[[maybe_unused]] std::string word = parallelReduce(wide, letters.begin(), letters.end(), std::string{}, std::plus<>{}, 64);
+		assert(word == expectedWord);
+	}
+
+	// Nested call from a task running on the pool
+	auto nested = pool.submit([&]() {
+		return parallelReduce(pool, input.begin(), input.end(), uint64_t{ 0 }, std::plus<>{});
+	});
+	[[maybe_unused]] uint64_t sumNested = nested.get();
+	assert(sumNested == sumSequential);
+
+	// Sorts on different key distributions
+	std::vector<uint32_t> keys(numElements);
+	std::mt19937 gen(42);
+	std::generate(keys.begin(), keys.end(), [&]() { return static_cast<uint32_t>(gen()); });
+	benchmarkSort("random", keys);
+	std::sort(keys.begin(), keys.end());
+	benchmarkSort("sorted", keys);
+	std::reverse(keys.begin(), keys.end());
+	benchmarkSort("reverse", keys);
+	std::generate(keys.begin(), keys.end(), [&]() { return static_cast<uint32_t>(gen() % 16); });
+	benchmarkSort("few unique", keys);
+
+	// Signed keys and sorting records by a key
+	std::vector<int64_t> signedKeys(100000);
+	std::generate(signedKeys.begin(), signedKeys.end(), [&]() { return static_cast<int64_t>(gen()) - (1ll << 31); });
+	parallelRadixSort(pool, signedKeys.begin(), signedKeys.end());
+	assert(std::is_sorted(signedKeys.begin(), signedKeys.end()));
+	std::vector<std::pair<int, size_t>> records(100000);
+	for (size_t i = 0; i < records.size(); ++i)
+		records[i] = { static_cast<int>(gen() % 100), i };
+	parallelRadixSort(pool, records.begin(), records.end(), [](const std::pair<int, size_t>& record) { return record.first; });
+	assert(std::is_sorted(records.begin(), records.end())); // Stable, so equal keys keep the order of their indices
+	parallelSort(pool, records.begin(), records.end(), std::greater<>{});
+	assert(std::is_sorted(records.begin(), records.end(), std::greater<>{}));
+
+	/* Possible result (1 worker on a single core machine):
+	for: sequential 131ms, std::execution::par 127ms, WSThreadPool 129ms
+	transform: sequential 14ms, std::execution::par 13ms, WSThreadPool 14ms
+	reduce: sequential 6ms, std::execution::par 5ms, WSThreadPool 6ms
+	inclusive scan: sequential 11ms, std::execution::par 18ms, WSThreadPool 24ms
+	random: std::sort 1260ms, std::execution::par 1596ms, samplesort 1156ms, radix sort 429ms
+	sorted: std::sort 282ms, std::execution::par 75ms, samplesort 214ms, radix sort 443ms
+	reverse: std::sort 205ms, std::execution::par 255ms, samplesort 130ms, radix sort 469ms
+	few unique: std::sort 396ms, std::execution::par 613ms, samplesort 438ms, radix sort 274ms
+	*/
+
+	return 0;
+}
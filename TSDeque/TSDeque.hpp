@@ -2,50 +2,95 @@
 #include <deque>
 #include <mutex>
 #include <condition_variable>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include "StoragePolicy.hpp"
 
-template<class T>
+// Thread-safe Deque implemented with a mutex and a condition variable
+// 'Storage' is std::shared_ptr<T> (default) or T to keep items by value. See StoragePolicy.hpp
+template<class T, class Storage = std::shared_ptr<T>>
 class TSDeque
 {	
 private:
-	std::deque<std::shared_ptr<T>> m_data;
-	std::mutex m_mutex;
+	using Policy = StoragePolicy<T, Storage>;
+public:
+	using Container = std::deque<Storage>;
+private:
+	Container m_data;
+	mutable std::mutex m_mutex;
 	std::condition_variable m_cond;
+	size_t m_waiters{0}; // Threads blocked in waitAndPop or waitAndPopBack
 public:
 	TSDeque(const TSDeque&) = delete;
 	TSDeque& operator=(const TSDeque&) = delete;
 	TSDeque() = default;
 	void push(T item);
+	template <class InputIt>
+	void pushRange(InputIt first, InputIt last);
 	bool tryPop(T& result);
-	std::shared_ptr<T> tryPop();
+	std::shared_ptr<T> tryPop() requires Policy::shared;
 	void waitAndPop(T& result);
-	std::shared_ptr<T> waitAndPop();
+	std::shared_ptr<T> waitAndPop() requires Policy::shared;
 	bool tryPopBack(T& result);
-	std::shared_ptr<T> tryPopBack();
+	std::shared_ptr<T> tryPopBack() requires Policy::shared;
 	void waitAndPopBack(T& result);
-	std::shared_ptr<T> waitAndPopBack();
+	std::shared_ptr<T> waitAndPopBack() requires Policy::shared;
+	template <class OutputIt>
+	size_t tryPopN(OutputIt out, size_t maxCount);
+	size_t drainAll(Container& out);
 	bool empty() const;
 };
 
-template<class T>
-void TSDeque<T>::push(T item) {
-	auto itemPtr = std::make_shared<T>(std::move(item));
+template<class T, class Storage>
+void TSDeque<T, Storage>::push(T item) {
+	// Under shared storage the item is allocated before taking the lock
+	auto stored = Policy::makeStored(std::move(item));
 	std::unique_lock lock{m_mutex};
-	m_data.emplace_back(itemPtr);
+	m_data.emplace_back(std::move(stored));
 	lock.unlock();
 	m_cond.notify_one();
 }
 
-template<class T>
-bool TSDeque<T>::tryPop(T& result) {
+// Push all items in [first, last) to the back under one lock acquisition
+// Wakes one waiting thread per item
+// Items are constructed from *first, so pass move iterators to move them in
+template<class T, class Storage>
+template<class InputIt>
+void TSDeque<T, Storage>::pushRange(InputIt first, InputIt last) {
+	// Shared storage allocates every item before taking the lock
+	std::vector<Storage> items;
+	if constexpr (Policy::shared) {
+		for (; first != last; ++first)
+			items.push_back(std::make_shared<T>(*first));
+	}
+	std::unique_lock lock{m_mutex};
+	size_t oldSize = m_data.size();
+	if constexpr (Policy::shared) {
+		for (auto& item : items)
+			m_data.emplace_back(std::move(item));
+	}
+	else {
+		for (; first != last; ++first)
+			m_data.emplace_back(*first);
+	}
+	size_t toWake = std::min(m_data.size() - oldSize, m_waiters);
+	lock.unlock();
+	for (size_t i = 0; i < toWake; ++i)
+		m_cond.notify_one();
+}
+
+template<class T, class Storage>
+bool TSDeque<T, Storage>::tryPop(T& result) {
 	std::scoped_lock lock{m_mutex};
 	if (m_data.empty()) return false;
-	result = std::move(*m_data.front());
+	result = std::move(Policy::itemOf(m_data.front()));
 	m_data.pop_front();
 	return true;
 }
 
-template<class T>
-std::shared_ptr<T> TSDeque<T>::tryPop() {
+template<class T, class Storage>
+std::shared_ptr<T> TSDeque<T, Storage>::tryPop() requires Policy::shared {
 	std::scoped_lock lock{m_mutex};
 	if (m_data.empty()) return std::make_shared<T>();
 	auto result = std::move(m_data.front());
@@ -53,34 +98,38 @@ std::shared_ptr<T> TSDeque<T>::tryPop() {
 	return result;
 }
 
-template<class T>
-void TSDeque<T>::waitAndPop(T& result) {
+template<class T, class Storage>
+void TSDeque<T, Storage>::waitAndPop(T& result) {
 	std::unique_lock lock{m_mutex};
+	++m_waiters;
 	m_cond.wait(lock, [&]() {return !m_data.empty(); });
-	result = std::move(*m_data.front());
+	--m_waiters;
+	result = std::move(Policy::itemOf(m_data.front()));
 	m_data.pop_front();
 }
 
-template<class T>
-std::shared_ptr<T> TSDeque<T>::waitAndPop() {
+template<class T, class Storage>
+std::shared_ptr<T> TSDeque<T, Storage>::waitAndPop() requires Policy::shared {
 	std::unique_lock lock{m_mutex};
+	++m_waiters;
 	m_cond.wait(lock, [this]() {return !m_data.empty(); });
+	--m_waiters;
 	auto result = std::move(m_data.front());
 	m_data.pop_front();
 	return result;
 }
 
-template<class T>
-bool TSDeque<T>::tryPopBack(T& result) {
+template<class T, class Storage>
+bool TSDeque<T, Storage>::tryPopBack(T& result) {
 	std::scoped_lock lock{m_mutex};
 	if (m_data.empty()) return false;
-	result = std::move(*m_data.back());
+	result = std::move(Policy::itemOf(m_data.back()));
 	m_data.pop_back();
 	return true;
 }
 
-template<class T>
-std::shared_ptr<T> TSDeque<T>::tryPopBack() {
+template<class T, class Storage>
+std::shared_ptr<T> TSDeque<T, Storage>::tryPopBack() requires Policy::shared {
 	std::scoped_lock lock{m_mutex};
 	if (m_data.empty()) return std::make_shared<T>();
 	auto result = std::move(m_data.back());
@@ -88,25 +137,55 @@ std::shared_ptr<T> TSDeque<T>::tryPopBack() {
 	return result;
 }
 
-template<class T>
-void TSDeque<T>::waitAndPopBack(T& result) {
+template<class T, class Storage>
+void TSDeque<T, Storage>::waitAndPopBack(T& result) {
 	std::unique_lock lock{m_mutex};
+	++m_waiters;
 	m_cond.wait(lock, [&]() {return !m_data.empty(); });
-	result = std::move(*m_data.back());
+	--m_waiters;
+	result = std::move(Policy::itemOf(m_data.back()));
 	m_data.pop_back();
 }
 
-template<class T>
-std::shared_ptr<T> TSDeque<T>::waitAndPopBack() {
+template<class T, class Storage>
+std::shared_ptr<T> TSDeque<T, Storage>::waitAndPopBack() requires Policy::shared {
 	std::unique_lock lock{m_mutex};
+	++m_waiters;
 	m_cond.wait(lock, [this]() {return !m_data.empty(); });
+	--m_waiters;
 	auto result = std::move(m_data.back());
 	m_data.pop_back();
 	return result;
 }
 
-template<class T>
-bool TSDeque<T>::empty() const {
+// Pop up to 'maxCount' items from the front into 'out' under one lock acquisition
+// Return the number of popped items
+template<class T, class Storage>
+template<class OutputIt>
+size_t TSDeque<T, Storage>::tryPopN(OutputIt out, size_t maxCount) {
+	std::scoped_lock lock{m_mutex};
+	size_t count = std::min(maxCount, m_data.size());
+	for (size_t i = 0; i < count; ++i)
+		*out++ = std::move(Policy::itemOf(m_data[i]));
+	m_data.erase(m_data.begin(), m_data.begin() + count);
+	return count;
+}
+
+// Take every pushed item by swapping the container out, O(1) under the lock
+// The previous contents of 'out' are discarded. Return the number of taken items
+template<class T, class Storage>
+size_t TSDeque<T, Storage>::drainAll(Container& out) {
+	Container drained;
+	{
+		std::scoped_lock lock{m_mutex};
+		m_data.swap(drained);
+	}
+	out.swap(drained);
+	return out.size();
+}
+
+template<class T, class Storage>
+bool TSDeque<T, Storage>::empty() const {
 	std::scoped_lock lock{m_mutex};
 	return m_data.empty();
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "TSDeque.hpp"
 #include <iostream>
 #include <vector>
+#include <iterator>
 #include <thread>
 #include <future>
 #include <unordered_map>
@@ -115,6 +116,38 @@ int main() {
 		assert(pair.second == iter);
 	}
 
+	// Batch push, pop and drain under one lock acquisition
+	std::vector<int> items{1, 2, 3, 4, 5, 6};
+	deque.pushRange(items.begin(), items.end());
+	std::vector<int> popped;
+	[[maybe_unused]] size_t count = deque.tryPopN(std::back_inserter(popped), 4);
+	assert(count == 4);
+	assert((popped == std::vector<int>{1, 2, 3, 4}));
+	TSDeque<int>::Container drained;
+	count = deque.drainAll(drained);
+	assert(count == 2);
+	assert(*drained.front() == 5 && *drained.back() == 6);
+	assert(deque.empty());
+	count = deque.tryPopN(std::back_inserter(popped), 4);
+	assert(count == 0);
+
+	// Items stored by value
+	TSDeque<int, int> valueDeque;
+	valueDeque.pushRange(items.begin(), items.end());
+	valueDeque.push(7);
+	int item{0};
+	[[maybe_unused]] bool poppedItem = valueDeque.tryPopBack(item);
+	assert(poppedItem && item == 7);
+	poppedItem = valueDeque.tryPop(item);
+	assert(poppedItem && item == 1);
+	popped.clear();
+	count = valueDeque.tryPopN(std::back_inserter(popped), 2);
+	assert(count == 2);
+	assert((popped == std::vector<int>{2, 3}));
+	TSDeque<int, int>::Container valueDrained;
+	count = valueDeque.drainAll(valueDrained);
+	assert(count == 3 && valueDrained.back() == 6);
+
 
 	return 0;
 }
\ No newline at end of file
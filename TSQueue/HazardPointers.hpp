@@ -0,0 +1,137 @@
+#pragma once
+#include <atomic>
+#include <array>
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+
+// Hazard pointers (Maged Michael) for lock-free structures whose nodes other threads may still be reading after they are unlinked
+// Before dereferencing a shared node, a thread publishes its address in one of its hazard slots with protect()
+// A thread that unlinks a node retires it instead of deleting it. Retired nodes are deleted in batches,
+// skipping those that some slot still holds, so a node is never freed under a reader and never reused under a CAS (no ABA)
+// Slots are global and shared by every structure, so a thread holds at most 'slotsPerThread' protected nodes at a time
+class HazardPointers
+{
+public:
+	static constexpr size_t slotsPerThread{ 2 };
+	static constexpr size_t maxThreads{ 256 }; // Threads that may hold slots at the same time
+	// Load 'source' and publish it in slot 'index' of the calling thread
+	// Returns a pointer that stays valid until the slot is cleared or reused, even if the node is unlinked and retired
+	template <class T>
+	static T* protect(size_t index, const std::atomic<T*>& source);
+	// Publish a pointer that the caller has validated itself
+	template <class T>
+	static void set(size_t index, T* pointer) { record().slots[index].store(pointer, std::memory_order_seq_cst); }
+	static void clear(size_t index) { record().slots[index].store(nullptr, std::memory_order_release); }
+	// Delete 'node' once no slot holds it. 'node' must already be unreachable for threads that have not protected it
+	template <class T>
+	static void retire(T* node);
+private:
+	struct alignas(64) Record {
+		std::atomic<bool> active{ false };
+		std::array<std::atomic<void*>, slotsPerThread> slots{};
+	};
+	struct Retired {
+		void* pointer;
+		void (*deleter)(void*);
+	};
+	// Slots and retired nodes of one thread. Gives the nodes it could not delete to the other threads when the thread exits
+	struct ThreadState {
+		Record* record{ nullptr };
+		std::vector<Retired> retired;
+		ThreadState();
+		~ThreadState();
+	};
+	// Nodes retired by threads that have exited. Deleted at program exit if no thread has adopted them
+	struct Orphans {
+		std::mutex mutex;
+		std::vector<Retired> nodes;
+		std::atomic<bool> any{ false };
+		~Orphans() { for (auto& node : nodes) node.deleter(node.pointer); }
+	};
+	// A scan costs a pass over every slot, so it runs once this many nodes are retired, which keeps it O(1) per node
+	static constexpr size_t scanThreshold{ 2 * maxThreads * slotsPerThread };
+	static std::array<Record, maxThreads> s_records;
+	static Orphans s_orphans;
+
+	static ThreadState& state() {
+		thread_local ThreadState state;
+		return state;
+	}
+	static Record& record() { return *state().record; }
+	// Delete every node in 'retired' that no slot holds
+	static void scan(std::vector<Retired>& retired);
+};
+
+inline std::array<HazardPointers::Record, HazardPointers::maxThreads> HazardPointers::s_records;
+inline HazardPointers::Orphans HazardPointers::s_orphans;
+
+inline HazardPointers::ThreadState::ThreadState() {
+	for (auto& candidate : s_records) {
+		bool expected = false;
+		if (!candidate.active.load(std::memory_order_relaxed) && candidate.active.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+			record = &candidate;
+			return;
+		}
+	}
+	throw std::runtime_error("Too many threads hold hazard pointers");
+}
+
+inline HazardPointers::ThreadState::~ThreadState() {
+	for (auto& slot : record->slots)
+		slot.store(nullptr, std::memory_order_release);
+	scan(retired);
+	if (!retired.empty()) {
+		std::scoped_lock lock{ s_orphans.mutex };
+		s_orphans.nodes.insert(s_orphans.nodes.end(), retired.begin(), retired.end());
+		s_orphans.any.store(true, std::memory_order_relaxed);
+	}
+	record->active.store(false, std::memory_order_release);
+}
+
+template <class T>
+T* HazardPointers::protect(size_t index, const std::atomic<T*>& source) {
+	auto& slot = record().slots[index];
+	T* pointer = source.load(std::memory_order_relaxed);
+	while (true) {
+		slot.store(pointer, std::memory_order_seq_cst);
+		// If 'source' still holds the pointer after the slot was published, the node was not retired before the slot became visible
+		T* current = source.load(std::memory_order_seq_cst);
+		if (current == pointer)
+			return pointer;
+		pointer = current;
+	}
+}
+
+template <class T>
+void HazardPointers::retire(T* node) {
+	auto& retired = state().retired;
+	retired.push_back({ node, [](void* pointer) { delete static_cast<T*>(pointer); } });
+	if (retired.size() >= scanThreshold)
+		scan(retired);
+}
+
+inline void HazardPointers::scan(std::vector<Retired>& retired) {
+	if (s_orphans.any.load(std::memory_order_relaxed)) {
+		std::scoped_lock lock{ s_orphans.mutex };
+		retired.insert(retired.end(), s_orphans.nodes.begin(), s_orphans.nodes.end());
+		s_orphans.nodes.clear();
+		s_orphans.any.store(false, std::memory_order_relaxed);
+	}
+	std::vector<void*> hazards;
+	for (auto& record : s_records) {
+		for (auto& slot : record.slots) {
+			if (void* pointer = slot.load(std::memory_order_seq_cst))
+				hazards.push_back(pointer);
+		}
+	}
+	std::sort(hazards.begin(), hazards.end());
+	std::erase_if(retired, [&hazards](const Retired& node) {
+		if (std::binary_search(hazards.begin(), hazards.end(), node.pointer))
+			return false;
+		node.deleter(node.pointer);
+		return true;
+	});
+}
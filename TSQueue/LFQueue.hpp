@@ -0,0 +1,126 @@
+#pragma once
+#include <atomic>
+#include <new>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include "HazardPointers.hpp"
+
+// Lock-free unbounded multi-producer multi-consumer queue (Michael and Scott)
+// Same dummy-node split as FTSQueue: 'm_head' points to a dummy node and the items live in the nodes after it,
+// so producers only touch the tail and consumers only touch the head. The two mutexes become CASes:
+//   push links the new node after the last node with a CAS on its 'next', then swings 'm_tail' to it
+//   pop swings 'm_head' to the next node, which becomes the new dummy, and moves the item out of it
+// 'm_tail' may lag one node behind. Any thread that sees it lagging moves it forward before retrying, so no thread waits for another
+// Unlinked dummies are freed through hazard pointers, since other threads may still be reading them
+template <class T>
+class LFQueue
+{
+	static_assert(std::is_nothrow_move_constructible_v<T> && std::is_nothrow_move_assignable_v<T>,
+		"An unlinked node cannot be given back, so moving an item out must not throw");
+private:
+	struct Node {
+		std::atomic<Node*> next{ nullptr };
+		alignas(T) std::byte storage[sizeof(T)]; // Holds an item until a consumer moves it out. Empty in the dummy
+		T* item() { return std::launder(reinterpret_cast<T*>(storage)); }
+	};
+	// Producers and consumers work on separate cache lines
+	alignas(64) std::atomic<Node*> m_head;
+	alignas(64) std::atomic<Node*> m_tail;
+	// Hazard slots used by the queue
+	static constexpr size_t firstSlot{ 0 };
+	static constexpr size_t nextSlot{ 1 };
+public:
+	LFQueue();
+	LFQueue(const LFQueue&) = delete;
+	LFQueue& operator=(const LFQueue&) = delete;
+	~LFQueue();
+	void push(T item);
+	bool tryPop(T& result);
+	// May be stale by the time it returns
+	bool empty() const;
+};
+
+template <class T>
+LFQueue<T>::LFQueue() {
+	Node* dummy = new Node();
+	m_head.store(dummy, std::memory_order_relaxed);
+	m_tail.store(dummy, std::memory_order_relaxed);
+}
+
+template <class T>
+LFQueue<T>::~LFQueue() {
+	// No thread is pushing or popping any more. Every node after the dummy holds an item
+	Node* node = m_head.load(std::memory_order_relaxed);
+	Node* next = node->next.load(std::memory_order_relaxed);
+	delete node;
+	for (node = next; node; node = next) {
+		next = node->next.load(std::memory_order_relaxed);
+		node->item()->~T();
+		delete node;
+	}
+}
+
+template <class T>
+void LFQueue<T>::push(T item) {
+	Node* node = new Node();
+	::new (static_cast<void*>(node->storage)) T(std::move(item));
+	while (true) {
+		Node* tail = HazardPointers::protect(firstSlot, m_tail);
+		Node* next = tail->next.load(std::memory_order_acquire);
+		if (next) {
+			// 'm_tail' lags behind the last node. Help the producer that linked 'next'
+			m_tail.compare_exchange_weak(tail, next, std::memory_order_release, std::memory_order_relaxed);
+			continue;
+		}
+		if (tail->next.compare_exchange_weak(next, node, std::memory_order_release, std::memory_order_relaxed)) {
+			// Linked. If this fails, another thread has already moved 'm_tail' on
+			m_tail.compare_exchange_strong(tail, node, std::memory_order_release, std::memory_order_relaxed);
+			break;
+		}
+	}
+	HazardPointers::clear(firstSlot);
+}
+
+template <class T>
+bool LFQueue<T>::tryPop(T& result) {
+	Node* head;
+	Node* next;
+	while (true) {
+		head = HazardPointers::protect(firstSlot, m_head);
+		next = head->next.load(std::memory_order_acquire);
+		HazardPointers::set(nextSlot, next);
+		// 'next' can only be retired after it has become the head and been popped in turn
+		// While 'head' is still the head, the slot was published in time
+		if (m_head.load(std::memory_order_seq_cst) != head)
+			continue;
+		if (!next) {
+			HazardPointers::clear(firstSlot);
+			return false;
+		}
+		Node* tail = m_tail.load(std::memory_order_acquire);
+		if (tail == head) {
+			// 'm_tail' lags behind. Move it on so that it never points to a retired dummy
+			m_tail.compare_exchange_strong(tail, next, std::memory_order_release, std::memory_order_relaxed);
+			continue;
+		}
+		if (m_head.compare_exchange_strong(head, next, std::memory_order_seq_cst, std::memory_order_relaxed))
+			break;
+	}
+	// 'next' is the new dummy. Only the thread that moved the head to it takes its item
+	T* item = next->item();
+	result = std::move(*item);
+	item->~T();
+	HazardPointers::clear(nextSlot);
+	HazardPointers::clear(firstSlot);
+	HazardPointers::retire(head);
+	return true;
+}
+
+template <class T>
+bool LFQueue<T>::empty() const {
+	Node* head = HazardPointers::protect(firstSlot, m_head);
+	bool result = head->next.load(std::memory_order_acquire) == nullptr;
+	HazardPointers::clear(firstSlot);
+	return result;
+}
@@ -0,0 +1,192 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+#include <bit>
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+#include <thread>
+#include "EventCount.hpp"
+
+// Bounded lock-free multi-producer multi-consumer queue (Dmitry Vyukov's ring buffer)
+// Items are stored inline in a power-of-two ring, so push and pop allocate nothing
+// Each cell carries a sequence number that tells producers and consumers whose turn the cell is:
+//   sequence == position         the cell is free for the producer that claims 'position'
+//   sequence == position + 1     the cell holds the item for the consumer that claims 'position'
+// A push or pop is one CAS on the enqueue or dequeue position and one release store to the cell
+// Blocking push() and waitAndPop() sleep on EventCounts, so the non-blocking paths never touch a mutex
+template <class T>
+class MPMCQueue
+{
+	static_assert(std::is_nothrow_move_constructible_v<T> && std::is_nothrow_move_assignable_v<T>,
+		"A claimed cell cannot be given back, so moving an item in or out must not throw");
+private:
+	struct Cell {
+		std::atomic<size_t> sequence;
+		alignas(T) std::byte storage[sizeof(T)];
+	};
+	std::unique_ptr<Cell[]> m_cells;
+	size_t m_mask;
+	// Producers and consumers claim positions on separate cache lines
+	alignas(64) std::atomic<size_t> m_enqueuePos{ 0 };
+	alignas(64) std::atomic<size_t> m_dequeuePos{ 0 };
+	alignas(64) EventCount m_notEmpty; // Consumers in waitAndPop() wait on this
+	EventCount m_notFull; // Producers in push() wait on this
+	static constexpr unsigned yieldRounds{ 16 }; // Attempts of the blocking calls before they sleep
+public:
+	// The capacity is rounded up to a power of two, and is at least 2
+	explicit MPMCQueue(size_t capacity);
+	MPMCQueue(const MPMCQueue&) = delete;
+	MPMCQueue& operator=(const MPMCQueue&) = delete;
+	~MPMCQueue();
+	// Push the item, waiting for room while the queue is full
+	void push(T item);
+	// Push the item if there is room. Returns false and leaves 'item' untouched if the queue is full
+	bool tryPush(T& item);
+	bool tryPop(T& result);
+	// Pop an item, waiting while the queue is empty
+	void waitAndPop(T& result);
+	// The results of empty() and size() may be stale by the time they return
+	bool empty() const;
+	size_t size() const;
+	size_t capacity() const { return m_mask + 1; }
+private:
+	T* itemIn(Cell& cell) { return std::launder(reinterpret_cast<T*>(cell.storage)); }
+	bool full() const;
+};
+
+template <class T>
+MPMCQueue<T>::MPMCQueue(size_t capacity)
+	: m_cells(new Cell[std::bit_ceil(std::max<size_t>(capacity, 2))]), m_mask(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1)
+{
+	for (size_t i = 0; i <= m_mask; ++i)
+		m_cells[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+template <class T>
+MPMCQueue<T>::~MPMCQueue() {
+	// No thread is pushing or popping any more, so every claimed cell holds an item
+	size_t end = m_enqueuePos.load(std::memory_order_relaxed);
+	for (size_t position = m_dequeuePos.load(std::memory_order_relaxed); position != end; ++position)
+		itemIn(m_cells[position & m_mask])->~T();
+}
+
+template <class T>
+void MPMCQueue<T>::push(T item) {
+	// Consumers usually free a cell soon. Yield a few times before paying for a sleep and a wakeup
+	for (unsigned round = 0; round < yieldRounds; ++round) {
+		if (tryPush(item))
+			return;
+		std::this_thread::yield();
+	}
+	while (!tryPush(item)) {
+		auto key = m_notFull.prepareWait();
+		// A consumer may have freed a cell after the failed push
+		if (!full())
+			m_notFull.cancelWait();
+		else
+			m_notFull.wait(key);
+	}
+}
+
+template <class T>
+bool MPMCQueue<T>::tryPush(T& item) {
+	size_t position = m_enqueuePos.load(std::memory_order_relaxed);
+	Cell* cell;
+	while (true) {
+		cell = &m_cells[position & m_mask];
+		size_t sequence = cell->sequence.load(std::memory_order_acquire);
+		auto diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position);
+		if (diff == 0) {
+			if (m_enqueuePos.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0)
+			return false; // The cell still holds the item from one lap ago: the queue is full
+		else
+			position = m_enqueuePos.load(std::memory_order_relaxed); // Another producer claimed the position
+	}
+	::new (static_cast<void*>(cell->storage)) T(std::move(item));
+	cell->sequence.store(position + 1, std::memory_order_release);
+	m_notEmpty.notifyOne();
+	return true;
+}
+
+template <class T>
+bool MPMCQueue<T>::tryPop(T& result) {
+	size_t position = m_dequeuePos.load(std::memory_order_relaxed);
+	Cell* cell;
+	while (true) {
+		cell = &m_cells[position & m_mask];
+		size_t sequence = cell->sequence.load(std::memory_order_acquire);
+		auto diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position + 1);
+		if (diff == 0) {
+			if (m_dequeuePos.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0)
+			return false; // No producer has filled the cell yet: the queue is empty
+		else
+			position = m_dequeuePos.load(std::memory_order_relaxed); // Another consumer claimed the position
+	}
+	T* item = itemIn(*cell);
+	result = std::move(*item);
+	item->~T();
+	// Free the cell for the producer one lap ahead
+	cell->sequence.store(position + m_mask + 1, std::memory_order_release);
+	m_notFull.notifyOne();
+	return true;
+}
+
+template <class T>
+void MPMCQueue<T>::waitAndPop(T& result) {
+	for (unsigned round = 0; round < yieldRounds; ++round) {
+		if (tryPop(result))
+			return;
+		std::this_thread::yield();
+	}
+	while (!tryPop(result)) {
+		auto key = m_notEmpty.prepareWait();
+		// A producer may have filled a cell after the failed pop
+		if (!empty())
+			m_notEmpty.cancelWait();
+		else
+			m_notEmpty.wait(key);
+	}
+}
+
+template <class T>
+bool MPMCQueue<T>::empty() const {
+	size_t position = m_dequeuePos.load(std::memory_order_acquire);
+	while (true) {
+		size_t sequence = m_cells[position & m_mask].sequence.load(std::memory_order_acquire);
+		auto diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position + 1);
+		if (diff <= 0)
+			return diff < 0;
+		// A consumer took the item after the position was read. Look at the next position
+		position = m_dequeuePos.load(std::memory_order_acquire);
+	}
+}
+
+template <class T>
+bool MPMCQueue<T>::full() const {
+	size_t position = m_enqueuePos.load(std::memory_order_acquire);
+	while (true) {
+		size_t sequence = m_cells[position & m_mask].sequence.load(std::memory_order_acquire);
+		auto diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position);
+		if (diff <= 0)
+			return diff < 0;
+		position = m_enqueuePos.load(std::memory_order_acquire);
+	}
+}
+
+template <class T>
+size_t MPMCQueue<T>::size() const {
+	size_t dequeuePos = m_dequeuePos.load(std::memory_order_acquire);
+	size_t enqueuePos = m_enqueuePos.load(std::memory_order_acquire);
+	// The positions are read one after the other, so clamp to what the ring can hold
+	return enqueuePos > dequeuePos ? std::min(enqueuePos - dequeuePos, capacity()) : 0;
+}
@@ -0,0 +1,167 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <span>
+#include <cstddef>
+#include <bit>
+#include <algorithm>
+#include <utility>
+#include <cassert>
+
+// Bounded wait-free queue for exactly one producer thread and one consumer thread
+// Every operation finishes in a bounded number of steps: no CAS loops, no locks, no waiting
+// Each side keeps a cached copy of the other side's index on its own cache line and only reloads it
+// when the cached value says the queue is full (producer) or empty (consumer), so in the steady state
+// the two threads do not touch each other's cache lines except to publish their progress
+// T must be default constructible: the ring holds live objects, which lets reserve() and peek() hand out slots in place
+// The queue never blocks. A producer that finds it full, or a consumer that finds it empty, decides how to wait
+template <class T>
+class SPSCQueue
+{
+private:
+	std::unique_ptr<T[]> m_slots;
+	size_t m_mask;
+	// Producer's cache line
+	alignas(64) std::atomic<size_t> m_tail{ 0 }; // Next position to write
+	size_t m_cachedHead{ 0 }; // Last value of m_head the producer has seen
+	size_t m_reserved{ 0 }; // Slots handed out by the last reserve()
+	// Consumer's cache line
+	alignas(64) std::atomic<size_t> m_head{ 0 }; // Next position to read
+	size_t m_cachedTail{ 0 }; // Last value of m_tail the consumer has seen
+	size_t m_peeked{ 0 }; // Slots handed out by the last peek()
+public:
+	// The capacity is rounded up to a power of two, and is at least 2
+	explicit SPSCQueue(size_t capacity);
+	SPSCQueue(const SPSCQueue&) = delete;
+	SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+	// Producer only
+	// Push the item if there is room. Returns false and leaves 'item' untouched if the queue is full
+	bool tryPush(T& item);
+	// Move as many items from the front of 'items' as there is room for, and publish them at once. Returns how many were pushed
+	size_t pushN(std::span<T> items);
+	// Up to 'maxCount' free slots that are contiguous in the ring. Fewer if the queue is nearly full or the ring wraps
+	// Write the items into the slots in place, then publish the first 'count' of them with commit(count)
+	std::span<T> reserve(size_t maxCount);
+	void commit(size_t count);
+
+	// Consumer only
+	bool tryPop(T& result);
+	// Move up to out.size() items into 'out' and free their slots at once. Returns how many were popped
+	size_t popN(std::span<T> out);
+	// Up to 'maxCount' items that are contiguous in the ring, to read in place. Free the first 'count' of them with consume(count)
+	std::span<T> peek(size_t maxCount);
+	void consume(size_t count);
+
+	// Either thread. The results may be stale by the time they return
+	bool empty() const { return size() == 0; }
+	size_t size() const;
+	size_t capacity() const { return m_mask + 1; }
+private:
+	// Number of free slots, at least 'wanted' if that many are free. Producer only
+	size_t freeSlots(size_t tail, size_t wanted);
+	// Number of readable items, at least 'wanted' if that many are readable. Consumer only
+	size_t readableSlots(size_t head, size_t wanted);
+};
+
+template <class T>
+SPSCQueue<T>::SPSCQueue(size_t capacity)
+	: m_slots(new T[std::bit_ceil(std::max<size_t>(capacity, 2))]()), m_mask(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1) {}
+
+template <class T>
+size_t SPSCQueue<T>::freeSlots(size_t tail, size_t wanted) {
+	size_t free = capacity() - (tail - m_cachedHead);
+	if (free < wanted) {
+		// Only now look at the consumer's cache line
+		m_cachedHead = m_head.load(std::memory_order_acquire);
+		free = capacity() - (tail - m_cachedHead);
+	}
+	return free;
+}
+
+template <class T>
+size_t SPSCQueue<T>::readableSlots(size_t head, size_t wanted) {
+	size_t readable = m_cachedTail - head;
+	if (readable < wanted) {
+		m_cachedTail = m_tail.load(std::memory_order_acquire);
+		readable = m_cachedTail - head;
+	}
+	return readable;
+}
+
+template <class T>
+bool SPSCQueue<T>::tryPush(T& item) {
+	size_t tail = m_tail.load(std::memory_order_relaxed);
+	if (freeSlots(tail, 1) == 0)
+		return false;
+	m_slots[tail & m_mask] = std::move(item);
+	m_tail.store(tail + 1, std::memory_order_release);
+	return true;
+}
+
+template <class T>
+size_t SPSCQueue<T>::pushN(std::span<T> items) {
+	size_t tail = m_tail.load(std::memory_order_relaxed);
+	size_t count = std::min(items.size(), freeSlots(tail, items.size()));
+	for (size_t i = 0; i < count; ++i)
+		m_slots[(tail + i) & m_mask] = std::move(items[i]);
+	m_tail.store(tail + count, std::memory_order_release);
+	return count;
+}
+
+template <class T>
+std::span<T> SPSCQueue<T>::reserve(size_t maxCount) {
+	size_t tail = m_tail.load(std::memory_order_relaxed);
+	size_t index = tail & m_mask;
+	m_reserved = std::min({ maxCount, freeSlots(tail, maxCount), capacity() - index });
+	return std::span<T>(m_slots.get() + index, m_reserved);
+}
+
+template <class T>
+void SPSCQueue<T>::commit(size_t count) {
+	assert(count <= m_reserved);
+	m_reserved = 0;
+	m_tail.store(m_tail.load(std::memory_order_relaxed) + count, std::memory_order_release);
+}
+
+template <class T>
+bool SPSCQueue<T>::tryPop(T& result) {
+	size_t head = m_head.load(std::memory_order_relaxed);
+	if (readableSlots(head, 1) == 0)
+		return false;
+	result = std::move(m_slots[head & m_mask]);
+	m_head.store(head + 1, std::memory_order_release);
+	return true;
+}
+
+template <class T>
+size_t SPSCQueue<T>::popN(std::span<T> out) {
+	size_t head = m_head.load(std::memory_order_relaxed);
+	size_t count = std::min(out.size(), readableSlots(head, out.size()));
+	for (size_t i = 0; i < count; ++i)
+		out[i] = std::move(m_slots[(head + i) & m_mask]);
+	m_head.store(head + count, std::memory_order_release);
+	return count;
+}
+
+template <class T>
+std::span<T> SPSCQueue<T>::peek(size_t maxCount) {
+	size_t head = m_head.load(std::memory_order_relaxed);
+	size_t index = head & m_mask;
+	m_peeked = std::min({ maxCount, readableSlots(head, maxCount), capacity() - index });
+	return std::span<T>(m_slots.get() + index, m_peeked);
+}
+
+template <class T>
+void SPSCQueue<T>::consume(size_t count) {
+	assert(count <= m_peeked);
+	m_peeked = 0;
+	m_head.store(m_head.load(std::memory_order_relaxed) + count, std::memory_order_release);
+}
+
+template <class T>
+size_t SPSCQueue<T>::size() const {
+	size_t head = m_head.load(std::memory_order_acquire);
+	size_t tail = m_tail.load(std::memory_order_acquire);
+	return tail > head ? std::min(tail - head, capacity()) : 0;
+}
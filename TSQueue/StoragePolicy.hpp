@@ -0,0 +1,23 @@
+#pragma once
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// How the lock-based containers (TSQueue, TSStack, TSDeque) keep an item. 'Storage' is their second template parameter:
+//   std::shared_ptr<T> (default) allocates every item on push, so the overloads that return a shared_ptr can hand it out without a copy
+//   T keeps items by value in the container's own storage, with no allocation per item. Only the T& overloads are available
+template <class T, class Storage>
+struct StoragePolicy
+{
+	static constexpr bool shared{ std::is_same_v<Storage, std::shared_ptr<T>> };
+	static_assert(shared || std::is_same_v<Storage, T>, "Storage must be std::shared_ptr<T> or T");
+	static T& itemOf(Storage& stored) {
+		if constexpr (shared) return *stored;
+		else return stored;
+	}
+	// Under shared storage this is the allocation, so containers call it before taking their lock
+	static Storage makeStored(T&& item) {
+		if constexpr (shared) return std::make_shared<T>(std::move(item));
+		else return std::move(item);
+	}
+};
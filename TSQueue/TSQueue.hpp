@@ -1,45 +1,89 @@
 #pragma once
 #include <queue>
 #include <mutex>
+#include <condition_variable>
 #include <memory>
+#include <vector>
+#include <algorithm>
+#include "StoragePolicy.hpp"
 
 // Thread-safe Queue implemented with a mutex and a condition variable
-template <class T>
+// 'Storage' is std::shared_ptr<T> (default) or T to keep items by value. See StoragePolicy.hpp
+template <class T, class Storage = std::shared_ptr<T>>
 class TSQueue
 {
 private:
-	std::queue<std::shared_ptr<T>> m_data;
+	using Policy = StoragePolicy<T, Storage>;
+public:
+	using Container = std::queue<Storage>;
+private:
+	Container m_data;
 	mutable std::mutex m_mutex;
 	std::condition_variable m_cond;
+	size_t m_waiters{0}; // Threads blocked in waitAndPop
 public:
 	TSQueue() = default;
 	TSQueue(const TSQueue& other) = delete;
 	TSQueue& operator=(const TSQueue& other) = delete;
 	void push(T item);
+	template <class InputIt>
+	void pushRange(InputIt first, InputIt last);
 	bool tryPop(T& result);
-	std::shared_ptr<T> tryPop();
+	std::shared_ptr<T> tryPop() requires Policy::shared;
 	void waitAndPop(T& result);
-	std::shared_ptr<T> waitAndPop();
+	std::shared_ptr<T> waitAndPop() requires Policy::shared;
+	template <class OutputIt>
+	size_t tryPopN(OutputIt out, size_t maxCount);
+	size_t drainAll(Container& out);
 	bool empty() const;
 };
 
 // Push and notify any waiting thread
-template <class T>
-void TSQueue<T>::push(T item) {
-	auto itemPtr = std::make_shared<T>(std::move(item));
+template <class T, class Storage>
+void TSQueue<T, Storage>::push(T item) {
+	// Under shared storage the item is allocated before taking the lock
+	auto stored = Policy::makeStored(std::move(item));
 	std::unique_lock lock{m_mutex};
-	m_data.push(itemPtr);
+	m_data.push(std::move(stored));
 	lock.unlock();
 	m_cond.notify_one();
 }
 
+// Push all items in [first, last) under one lock acquisition
+// Wakes one waiting thread per item, so a small batch does not wake every waiter only for most of them to sleep again
+// Items are constructed from *first, so pass move iterators to move them in
+template <class T, class Storage>
+template <class InputIt>
+void TSQueue<T, Storage>::pushRange(InputIt first, InputIt last) {
+	// Shared storage allocates every item before taking the lock
+	std::vector<Storage> items;
+	if constexpr (Policy::shared) {
+		for (; first != last; ++first)
+			items.push_back(std::make_shared<T>(*first));
+	}
+	std::unique_lock lock{m_mutex};
+	size_t oldSize = m_data.size();
+	if constexpr (Policy::shared) {
+		for (auto& item : items)
+			m_data.emplace(std::move(item));
+	}
+	else {
+		for (; first != last; ++first)
+			m_data.emplace(*first);
+	}
+	size_t toWake = std::min(m_data.size() - oldSize, m_waiters);
+	lock.unlock();
+	for (size_t i = 0; i < toWake; ++i)
+		m_cond.notify_one();
+}
+
 // Try to pop a pushed item
 // If successful, return true. Otherwise, return false
-template <class T>
-bool TSQueue<T>::tryPop(T& result) {
+template <class T, class Storage>
+bool TSQueue<T, Storage>::tryPop(T& result) {
 	std::scoped_lock lock{m_mutex};
 	if (m_data.empty()) return false;
-	result = std::move(*m_data.front());
+	result = std::move(Policy::itemOf(m_data.front()));
 	m_data.pop();
 	return true;
 }
@@ -47,8 +91,8 @@ bool TSQueue<T>::tryPop(T& result) {
 // Try to pop a pushed item
 // If successful, return a shared pointer to the popped item
 // Otherwise, return an empty shared pointer
-template <class T>
-std::shared_ptr<T> TSQueue<T>::tryPop() {
+template <class T, class Storage>
+std::shared_ptr<T> TSQueue<T, Storage>::tryPop() requires Policy::shared {
 	std::scoped_lock lock{m_mutex};
 	if (m_data.empty()) return std::make_shared<T>();
 	auto result = std::move(m_data.front());
@@ -57,27 +101,59 @@ std::shared_ptr<T> TSQueue<T>::tryPop() {
 }
 
 // Wait for a pushed item and then pop it
-template <class T>
-void TSQueue<T>::waitAndPop(T& result) {
+template <class T, class Storage>
+void TSQueue<T, Storage>::waitAndPop(T& result) {
 	std::unique_lock lock{m_mutex};
+	++m_waiters;
 	m_cond.wait(lock, [this]() {return !m_data.empty(); });
-	result = std::move(*m_data.front());
+	--m_waiters;
+	result = std::move(Policy::itemOf(m_data.front()));
 	m_data.pop();
 }
 
 // Wait for a pushed item and then pop it
-template <class T>
-std::shared_ptr<T> TSQueue<T>::waitAndPop() {
+template <class T, class Storage>
+std::shared_ptr<T> TSQueue<T, Storage>::waitAndPop() requires Policy::shared {
 	std::unique_lock lock{m_mutex};
+	++m_waiters;
 	m_cond.wait(lock, [this]() {return !m_data.empty(); });
+	--m_waiters;
 	auto result = std::move(m_data.front());
 	m_data.pop();
 	return result;
 }
 
+// Pop up to 'maxCount' items into 'out' under one lock acquisition
+// Return the number of popped items
+template <class T, class Storage>
+template <class OutputIt>
+size_t TSQueue<T, Storage>::tryPopN(OutputIt out, size_t maxCount) {
+	std::scoped_lock lock{m_mutex};
+	size_t count = std::min(maxCount, m_data.size());
+	for (size_t i = 0; i < count; ++i) {
+		*out++ = std::move(Policy::itemOf(m_data.front()));
+		m_data.pop();
+	}
+	return count;
+}
+
+// Take every queued item by swapping the container out, O(1) under the lock
+// The previous contents of 'out' are discarded. Return the number of taken items
+template <class T, class Storage>
+size_t TSQueue<T, Storage>::drainAll(Container& out) {
+	// The empty replacement is constructed, and the old contents of 'out' destroyed, outside the lock
+	Container drained;
+	{
+		std::scoped_lock lock{m_mutex};
+		m_data.swap(drained);
+	}
+	out.swap(drained);
+	return out.size();
+}
+
 // Check if the stack is empty
-template <class T>
-bool TSQueue<T>::empty() const {
+template <class T, class Storage>
+bool TSQueue<T, Storage>::empty() const {
 	std::scoped_lock lock{m_mutex};
 	return m_data.empty();
 }
\ No newline at end of file
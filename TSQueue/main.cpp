@@ -1,4 +1,9 @@
 #include "TSQueue.hpp"
+#include "FTSQueue.hpp"
+#include "MPMCQueue.hpp"
+#include "SPSCQueue.hpp"
+#include "LFQueue.hpp"
+#include "AllocationCounter.hpp"
 #include <iostream>
 #include <vector>
 #include <thread>
@@ -6,6 +11,12 @@
 #include <unordered_map>
 #include <cassert>
 #include <latch>
+#include <chrono>
+#include <atomic>
+#include <string>
+#include <algorithm>
+#include <span>
+#include <iterator>
 
 constexpr size_t iter {2};
 std::latch latch{iter * 3}; // Make sure the threads start at the same time
@@ -39,6 +50,312 @@ std::vector<int> tryPop(TSQueue<int>& queue) {
 	return result;
 }
 
+// Producers push their share of [0, numItems) while consumers pop with tryPop until every item has been taken
+// Returns the time taken. Every item must be popped exactly once
+template <class Queue>
+std::chrono::milliseconds benchmarkQueue(Queue& queue, size_t numProducers, size_t numConsumers, size_t numItems) {
+	std::vector<std::atomic<int>> seen(numItems);
+	std::atomic<size_t> popped{0};
+	auto t1 = std::chrono::steady_clock::now();
+	{
+		std::vector<std::jthread> threads;
+		for (size_t p = 0; p < numProducers; ++p) {
+			threads.emplace_back([&queue, p, numProducers, numItems]() {
+				for (size_t i = p; i < numItems; i += numProducers) {
+					if constexpr (requires { queue.tryPush(i); }) {
+						// Bounded queue: back off while it is full
+						while (!queue.tryPush(i))
+							std::this_thread::yield();
+					}
+					else
+						queue.push(i);
+				}
+			});
+		}
+		for (size_t c = 0; c < numConsumers; ++c) {
+			threads.emplace_back([&queue, &seen, &popped, numItems]() {
+				size_t item;
+				while (popped.load(std::memory_order_relaxed) < numItems) {
+					if (queue.tryPop(item)) {
+						seen[item].fetch_add(1, std::memory_order_relaxed);
+						popped.fetch_add(1, std::memory_order_relaxed);
+					}
+					else
+						std::this_thread::yield();
+				}
+			});
+		}
+	}
+	auto t2 = std::chrono::steady_clock::now();
+	for ([[maybe_unused]] auto& count : seen)
+		assert(count.load() == 1);
+	return std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1);
+}
+
+// Blocking push on a full ring and waitAndPop on an empty one, with more threads than slots
+void testMPMCBlocking() {
+	constexpr size_t numItems{100000};
+	MPMCQueue<size_t> queue(4);
+	std::vector<std::atomic<int>> seen(numItems);
+	{
+		std::vector<std::jthread> threads;
+		for (size_t p = 0; p < 3; ++p) {
+			threads.emplace_back([&queue, p]() {
+				for (size_t i = p; i < numItems; i += 3)
+					queue.push(i);
+			});
+		}
+		for (size_t c = 0; c < 4; ++c) {
+			threads.emplace_back([&queue, &seen]() {
+				for (size_t i = 0; i < numItems / 4; ++i) {
+					size_t item;
+					queue.waitAndPop(item);
+					seen[item].fetch_add(1, std::memory_order_relaxed);
+				}
+			});
+		}
+	}
+	for ([[maybe_unused]] auto& count : seen)
+		assert(count.load() == 1);
+	assert(queue.empty() && queue.size() == 0);
+	// Items left in the ring are destroyed with it
+	auto item = std::make_shared<int>(1);
+	{
+		MPMCQueue<std::shared_ptr<int>> sharedQueue(2);
+		auto copy = item;
+		[[maybe_unused]] bool pushed = sharedQueue.tryPush(copy);
+		assert(pushed && !copy);
+		copy = item;
+		pushed = sharedQueue.tryPush(copy);
+		assert(pushed);
+		copy = item;
+		pushed = sharedQueue.tryPush(copy);
+		assert(!pushed && copy);
+		assert(item.use_count() == 4);
+	}
+	assert(item.use_count() == 1);
+}
+
+// Push one item, yielding while a bounded queue is full
+template <class Queue>
+void pushOne(Queue& queue, size_t item) {
+	if constexpr (requires { queue.tryPush(item); }) {
+		while (!queue.tryPush(item))
+			std::this_thread::yield();
+	}
+	else
+		queue.push(item);
+}
+
+// Pop one item, yielding while the queue is empty
+template <class Queue>
+size_t popOne(Queue& queue) {
+	size_t item;
+	while (!queue.tryPop(item))
+		std::this_thread::yield();
+	return item;
+}
+
+// Messages per second from one producer to one consumer
+// 'batch' > 1 moves the items with pushN/popN, 'batch' == 0 writes and reads them in place with reserve/commit and peek/consume
+template <class Queue>
+double spscThroughput(Queue& queue, size_t numItems, size_t batch = 1) {
+	auto t1 = std::chrono::steady_clock::now();
+	std::jthread producer([&queue, numItems, batch]() {
+		if constexpr (requires { queue.pushN(std::span<size_t>{}); }) {
+			if (batch == 0) {
+				for (size_t next = 0; next < numItems;) {
+					auto slots = queue.reserve(numItems - next);
+					for (auto& slot : slots)
+						slot = next++;
+					queue.commit(slots.size());
+					if (slots.empty())
+						std::this_thread::yield();
+				}
+				return;
+			}
+			if (batch > 1) {
+				std::vector<size_t> items(batch);
+				for (size_t next = 0; next < numItems;) {
+					size_t count = std::min(batch, numItems - next);
+					for (size_t i = 0; i < count; ++i)
+						items[i] = next + i;
+					for (size_t pushed = 0; pushed < count;) {
+						pushed += queue.pushN(std::span<size_t>(items.data() + pushed, count - pushed));
+						if (pushed < count)
+							std::this_thread::yield();
+					}
+					next += count;
+				}
+				return;
+			}
+		}
+		for (size_t i = 0; i < numItems; ++i)
+			pushOne(queue, i);
+	});
+	size_t expected = 0;
+	if constexpr (requires { queue.popN(std::span<size_t>{}); }) {
+		std::vector<size_t> items(std::max<size_t>(batch, 1));
+		while (expected < numItems && batch != 1) {
+			if (batch == 0) {
+				auto slots = queue.peek(numItems);
+				for ([[maybe_unused]] size_t item : slots) {
+					[[maybe_unused]] size_t want = expected++;
+					assert(item == want);
+				}
+				queue.consume(slots.size());
+				if (slots.empty())
+					std::this_thread::yield();
+			}
+			else {
+				size_t count = queue.popN(items);
+				for (size_t i = 0; i < count; ++i) {
+					[[maybe_unused]] size_t want = expected++;
+					assert(items[i] == want);
+				}
+				if (count == 0)
+					std::this_thread::yield();
+			}
+		}
+	}
+	while (expected < numItems) {
+		[[maybe_unused]] size_t item = popOne(queue);
+		assert(item == expected);
+		++expected;
+	}
+	producer.join();
+	auto t2 = std::chrono::steady_clock::now();
+	return numItems / std::chrono::duration<double>(t2 - t1).count();
+}
+
+// Round trip latency of a message sent to an echo thread and back through a pair of queues
+// Returns the median and the 99th percentile in microseconds
+template <class Queue>
+std::pair<double, double> roundTrip(Queue& ping, Queue& pong, size_t numRounds) {
+	std::jthread echo([&ping, &pong, numRounds]() {
+		for (size_t i = 0; i < numRounds; ++i)
+			pushOne(pong, popOne(ping));
+	});
+	std::vector<double> latencies;
+	latencies.reserve(numRounds);
+	for (size_t i = 0; i < numRounds; ++i) {
+		auto t1 = std::chrono::steady_clock::now();
+		pushOne(ping, i);
+		[[maybe_unused]] size_t item = popOne(pong);
+		assert(item == i);
+		latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t1).count());
+	}
+	std::sort(latencies.begin(), latencies.end());
+	return { latencies[latencies.size() / 2], latencies[latencies.size() * 99 / 100] };
+}
+
+// One producer and one consumer through each queue
+void benchmarkSPSC() {
+	constexpr size_t numItems{2000000};
+	constexpr size_t numRounds{20000};
+	auto report = [](const std::string& name, double throughput, std::pair<double, double> latency) {
+		std::cout << name << ": " << throughput / 1e6 << "M messages/s";
+		if (latency.first > 0)
+			std::cout << ", round trip p50 " << latency.first << "us, p99 " << latency.second << "us";
+		std::cout << "\n";
+	};
+	{
+		TSQueue<size_t> queue, ping, pong;
+		auto throughput = spscThroughput(queue, numItems);
+		report("TSQueue", throughput, roundTrip(ping, pong, numRounds));
+	}
+	{
+		FTSQueue<size_t> queue, ping, pong;
+		auto throughput = spscThroughput(queue, numItems);
+		report("FTSQueue", throughput, roundTrip(ping, pong, numRounds));
+	}
+	{
+		SPSCQueue<size_t> queue(1024), ping(1024), pong(1024);
+		auto throughput = spscThroughput(queue, numItems);
+		report("SPSCQueue", throughput, roundTrip(ping, pong, numRounds));
+		report("SPSCQueue pushN/popN of 64", spscThroughput(queue, numItems, 64), {});
+		report("SPSCQueue reserve/commit", spscThroughput(queue, numItems, 0), {});
+	}
+}
+
+// Messages per second from one producer to one consumer moving 'batch' items per lock acquisition with pushRange and tryPopN
+// 'drain' makes the consumer take everything queued at once with drainAll
+double batchThroughput(size_t numItems, size_t batch, bool drain = false) {
+	TSQueue<size_t> queue;
+	auto t1 = std::chrono::steady_clock::now();
+	std::jthread producer([&queue, numItems, batch]() {
+		std::vector<size_t> items(batch);
+		for (size_t next = 0; next < numItems; next += batch) {
+			size_t count = std::min(batch, numItems - next);
+			for (size_t i = 0; i < count; ++i)
+				items[i] = next + i;
+			queue.pushRange(items.begin(), items.begin() + count);
+		}
+	});
+	std::vector<size_t> items(batch);
+	TSQueue<size_t>::Container drained;
+	for (size_t expected = 0; expected < numItems;) {
+		size_t count = drain ? queue.drainAll(drained) : queue.tryPopN(items.begin(), batch);
+		for (size_t i = 0; i < count; ++i, ++expected) {
+			if (drain) {
+				assert(*drained.front() == expected);
+				drained.pop();
+			}
+			else
+				assert(items[i] == expected);
+		}
+		if (count == 0)
+			std::this_thread::yield();
+	}
+	producer.join();
+	auto t2 = std::chrono::steady_clock::now();
+	return numItems / std::chrono::duration<double>(t2 - t1).count();
+}
+
+// pushRange wakes one waiter per item, so every blocked consumer gets an item
+void testBatchWakeups() {
+	TSQueue<int> queue;
+	constexpr int numConsumers{4};
+	std::atomic<int> sum{0};
+	{
+		std::vector<std::jthread> consumers;
+		for (int i = 0; i < numConsumers; ++i) {
+			consumers.emplace_back([&queue, &sum]() {
+				int item;
+				queue.waitAndPop(item);
+				sum += item;
+			});
+		}
+		std::vector<int> items{1, 2, 3, 4};
+		queue.pushRange(items.begin(), items.begin() + 3);
+		queue.pushRange(items.begin() + 3, items.end());
+	}
+	assert(sum == 10);
+	assert(queue.empty());
+}
+
+// Heap allocations per item and throughput of one producer and one consumer passing strings through a TSQueue with the given storage
+// The strings fit in the small string buffer, so only the queue allocates
+template <class Storage>
+void benchmarkStorage(const std::string& name, size_t numItems) {
+	TSQueue<std::string, Storage> queue;
+	auto before = allocations.load();
+	auto t1 = std::chrono::steady_clock::now();
+	std::jthread producer([&queue, numItems]() {
+		for (size_t i = 0; i < numItems; ++i)
+			queue.push(std::to_string(i % 1000));
+	});
+	std::string item;
+	for (size_t i = 0; i < numItems; ++i) {
+		while (!queue.tryPop(item))
+			std::this_thread::yield();
+		assert(item == std::to_string(i % 1000));
+	}
+	producer.join();
+	auto t2 = std::chrono::steady_clock::now();
+	std::cout << name << ": " << static_cast<double>(allocations.load() - before) / numItems << " allocations per item, "
+		<< std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count() << "ms\n";
+}
 
 int main() {
 	// Create a thread-safe queue and containers for futures and threads
@@ -78,6 +395,83 @@ int main() {
 		assert(pair.second == iter);
 	}
 
+	// Items stored by value against one shared_ptr per item
+	benchmarkStorage<std::shared_ptr<std::string>>("shared_ptr storage", 1000000);
+	benchmarkStorage<std::string>("Value storage", 1000000);
+	TSQueue<int, int> valueQueue;
+	std::vector<int> values{1, 2, 3};
+	valueQueue.pushRange(values.begin(), values.end());
+	valueQueue.push(4);
+	int value;
+	valueQueue.waitAndPop(value);
+	assert(value == 1);
+	std::vector<int> popped;
+	[[maybe_unused]] size_t count = valueQueue.tryPopN(std::back_inserter(popped), 2);
+	assert(count == 2);
+	assert((popped == std::vector<int>{2, 3}));
+	TSQueue<int, int>::Container drained;
+	count = valueQueue.drainAll(drained);
+	assert(count == 1 && drained.front() == 4);
+
+	// Value storage still allocates one deque block per 16 strings
+	/* Possible result (single core machine):
+	shared_ptr storage: 1.03126 allocations per item, 120ms
+	Value storage: 0.062512 allocations per item, 71ms
+	*/
+
+	// Batch push, pop and drain under one lock acquisition
+	testBatchWakeups();
+	for (size_t batch : { 1, 4, 16, 64, 256, 1024 })
+		std::cout << "TSQueue batch " << batch << ": " << batchThroughput(2000000, batch) / 1e6 << "M messages/s\n";
+	std::cout << "TSQueue batch 64, drainAll: " << batchThroughput(2000000, 64, true) / 1e6 << "M messages/s\n";
+
+	/* Possible result (single core machine):
+	TSQueue batch 1: 7.08598M messages/s
+	TSQueue batch 4: 10.6497M messages/s
+	TSQueue batch 16: 12.6336M messages/s
+	TSQueue batch 64: 14.3915M messages/s
+	TSQueue batch 256: 11.7527M messages/s
+	TSQueue batch 1024: 12.0197M messages/s
+	TSQueue batch 64, drainAll: 12.8454M messages/s
+	*/
+
+	// Wait-free single producer single consumer ring
+	benchmarkSPSC();
+
+	/* Possible result (single core machine):
+	TSQueue: 7.70924M messages/s, round trip p50 2.019us, p99 2.455us
+	FTSQueue: 5.32677M messages/s, round trip p50 1.48us, p99 2.644us
+	SPSCQueue: 179.712M messages/s, round trip p50 1.231us, p99 2.229us
+	SPSCQueue pushN/popN of 64: 175.749M messages/s
+	SPSCQueue reserve/commit: 288.439M messages/s
+	*/
+
+	// Lock-free queues against the mutex-based ones: the unbounded Michael-Scott list and the ring with items stored inline
+	testMPMCBlocking();
+	constexpr size_t numItems{1000000};
+	for (size_t pairs : { 1, 2, 4, 8, 16, 32, 64 }) {
+		TSQueue<size_t> tsQueue;
+		FTSQueue<size_t> ftsQueue;
+		LFQueue<size_t> lfQueue;
+		MPMCQueue<size_t> mpmcQueue(1024);
+		auto tsTime = benchmarkQueue(tsQueue, pairs, pairs, numItems);
+		auto ftsTime = benchmarkQueue(ftsQueue, pairs, pairs, numItems);
+		auto lfTime = benchmarkQueue(lfQueue, pairs, pairs, numItems);
+		auto mpmcTime = benchmarkQueue(mpmcQueue, pairs, pairs, numItems);
+		assert(lfQueue.empty());
+		std::cout << pairs << " producers, " << pairs << " consumers: TSQueue " << tsTime.count() << "ms, FTSQueue " << ftsTime.count()
+			<< "ms, LFQueue " << lfTime.count() << "ms, MPMCQueue " << mpmcTime.count() << "ms\n";
+	}
+
+	/* Possible result (single core machine):
+	1 producers, 1 consumers: TSQueue 137ms, FTSQueue 199ms, LFQueue 137ms, MPMCQueue 68ms
+	2 producers, 2 consumers: TSQueue 146ms, FTSQueue 211ms, LFQueue 138ms, MPMCQueue 66ms
+	4 producers, 4 consumers: TSQueue 150ms, FTSQueue 231ms, LFQueue 156ms, MPMCQueue 77ms
+	8 producers, 8 consumers: TSQueue 157ms, FTSQueue 211ms, LFQueue 150ms, MPMCQueue 81ms
+	16 producers, 16 consumers: TSQueue 153ms, FTSQueue 232ms, LFQueue 146ms, MPMCQueue 106ms
+	32 producers, 32 consumers: TSQueue 179ms, FTSQueue 244ms, LFQueue 163ms, MPMCQueue 134ms
+	64 producers, 64 consumers: TSQueue 176ms, FTSQueue 272ms, LFQueue 177ms, MPMCQueue 158ms
+	*/
 
 	return 0;
 }
\ No newline at end of file
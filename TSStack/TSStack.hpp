@@ -1,49 +1,93 @@
 #pragma once
 #include <mutex>
+#include <condition_variable>
 #include <stack>
 #include <memory>
+#include <vector>
+#include <algorithm>
+#include "StoragePolicy.hpp"
 //1. Ensure that no thread observes a state where the invariants
 // of the data structure have been broken by other threads
 //2. Avoid race conditions inherent in the interface of the data structure
 
 // Thread-safe Stack implemented with a mutex and a condition variable
-template<class T>
+// 'Storage' is std::shared_ptr<T> (default) or T to keep items by value. See StoragePolicy.hpp
+template<class T, class Storage = std::shared_ptr<T>>
 class TSStack
 {
 private:
-	std::stack<std::shared_ptr<T>> m_data;
+	using Policy = StoragePolicy<T, Storage>;
+public:
+	using Container = std::stack<Storage, std::vector<Storage>>;
+private:
+	Container m_data;
 	mutable std::mutex m_mutex;
 	std::condition_variable m_cond;
+	size_t m_waiters{0}; // Threads blocked in waitAndPop
 public:
 	TSStack() = default;
 	TSStack(const TSStack& other) = delete;
 	TSStack& operator=(const TSStack& other) = delete;
 	void push(T item);
+	template <class InputIt>
+	void pushRange(InputIt first, InputIt last);
 	bool tryPop(T& result);
-	std::shared_ptr<T> tryPop();
+	std::shared_ptr<T> tryPop() requires Policy::shared;
 	void waitAndPop(T& result);
-	std::shared_ptr<T> waitAndPop();
+	std::shared_ptr<T> waitAndPop() requires Policy::shared;
+	template <class OutputIt>
+	size_t tryPopN(OutputIt out, size_t maxCount);
+	size_t drainAll(Container& out);
 	bool empty() const;
 };
 
 
 // Push and notify any waiting thread
-template<class T>
-void TSStack<T>::push(T item) {
-	auto itemPtr = std::make_shared<T>(std::move(item));
+template<class T, class Storage>
+void TSStack<T, Storage>::push(T item) {
+	// Under shared storage the item is allocated before taking the lock
+	auto stored = Policy::makeStored(std::move(item));
 	std::unique_lock lock{m_mutex};
-	m_data.push(itemPtr);
+	m_data.push(std::move(stored));
 	lock.unlock();
 	m_cond.notify_one();
 }
 
+// Push all items in [first, last) under one lock acquisition. The last item ends up on top
+// Wakes one waiting thread per item
+// Items are constructed from *first, so pass move iterators to move them in
+template<class T, class Storage>
+template<class InputIt>
+void TSStack<T, Storage>::pushRange(InputIt first, InputIt last) {
+	// Shared storage allocates every item before taking the lock
+	std::vector<Storage> items;
+	if constexpr (Policy::shared) {
+		for (; first != last; ++first)
+			items.push_back(std::make_shared<T>(*first));
+	}
+	std::unique_lock lock{m_mutex};
+	size_t oldSize = m_data.size();
+	if constexpr (Policy::shared) {
+		for (auto& item : items)
+			m_data.emplace(std::move(item));
+	}
+	else {
+		for (; first != last; ++first)
+			m_data.emplace(*first);
+	}
+	size_t toWake = std::min(m_data.size() - oldSize, m_waiters);
+	lock.unlock();
+	for (size_t i = 0; i < toWake; ++i)
+		m_cond.notify_one();
+}
+
 // Try to pop a pushed item
 // If successful, return true. Otherwise, return false
-template<class T>
-bool TSStack<T>::tryPop(T& result) {
+template<class T, class Storage>
+bool TSStack<T, Storage>::tryPop(T& result) {
 	std::scoped_lock lock{m_mutex};
 	if (m_data.empty()) return false;
-	result = std::move(*m_data.top());
+	result = std::move(Policy::itemOf(m_data.top()));
 	m_data.pop();
 	return true;
 }
@@ -51,8 +95,8 @@ bool TSStack<T>::tryPop(T& result) {
 // Try to pop a pushed item
 // If successful, return a shared pointer to the popped item
 // Otherwise, return an empty shared pointer
-template<class T>
-std::shared_ptr<T> TSStack<T>::tryPop() {
+template<class T, class Storage>
+std::shared_ptr<T> TSStack<T, Storage>::tryPop() requires Policy::shared {
 	std::scoped_lock lock{m_mutex};
 	if (m_data.empty()) return std::make_shared<T>();
 	auto result = std::move(m_data.top());
@@ -61,27 +105,58 @@ std::shared_ptr<T> TSStack<T>::tryPop() {
 }
 
 // Wait for a pushed item and then pop it
-template<class T>
-void TSStack<T>::waitAndPop(T& result) {
+template<class T, class Storage>
+void TSStack<T, Storage>::waitAndPop(T& result) {
 	std::unique_lock lock{m_mutex};
+	++m_waiters;
 	m_cond.wait(lock, [this]() {return !m_data.empty(); });
-	result = std::move(*m_data.top());
+	--m_waiters;
+	result = std::move(Policy::itemOf(m_data.top()));
 	m_data.pop();
 }
 
 // Wait for a pushed item and then pop it
-template<class T>
-std::shared_ptr<T> TSStack<T>::waitAndPop() {
+template<class T, class Storage>
+std::shared_ptr<T> TSStack<T, Storage>::waitAndPop() requires Policy::shared {
 	std::unique_lock lock{m_mutex};
+	++m_waiters;
 	m_cond.wait(lock, [this]() {return !m_data.empty(); });
+	--m_waiters;
 	auto result = std::move(m_data.top());
 	m_data.pop();
 	return result;
 }
 
+// Pop up to 'maxCount' items into 'out' under one lock acquisition, top first
+// Return the number of popped items
+template<class T, class Storage>
+template<class OutputIt>
+size_t TSStack<T, Storage>::tryPopN(OutputIt out, size_t maxCount) {
+	std::scoped_lock lock{m_mutex};
+	size_t count = std::min(maxCount, m_data.size());
+	for (size_t i = 0; i < count; ++i) {
+		*out++ = std::move(Policy::itemOf(m_data.top()));
+		m_data.pop();
+	}
+	return count;
+}
+
+// Take every pushed item by swapping the container out, O(1) under the lock
+// The previous contents of 'out' are discarded. Return the number of taken items
+template<class T, class Storage>
+size_t TSStack<T, Storage>::drainAll(Container& out) {
+	Container drained;
+	{
+		std::scoped_lock lock{m_mutex};
+		m_data.swap(drained);
+	}
+	out.swap(drained);
+	return out.size();
+}
+
 // Check if the stack is empty
-template<class T>
-bool TSStack<T>::empty() const {
+template<class T, class Storage>
+bool TSStack<T, Storage>::empty() const {
 	std::scoped_lock lock{m_mutex};
 	return m_data.empty();
 }
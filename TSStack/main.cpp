@@ -1,6 +1,7 @@
 #include "TSStack.hpp"
 #include <iostream>
 #include <vector>
+#include <iterator>
 #include <thread>
 #include <future>
 #include <unordered_map>
@@ -78,6 +79,36 @@ int main() {
 		assert(pair.second == iter);
 	}
 
+	// Batch push, pop and drain under one lock acquisition
+	std::vector<int> items{1, 2, 3, 4, 5, 6};
+	stack.pushRange(items.begin(), items.end());
+	std::vector<int> popped;
+	[[maybe_unused]] size_t count = stack.tryPopN(std::back_inserter(popped), 4);
+	assert(count == 4);
+	assert((popped == std::vector<int>{6, 5, 4, 3}));
+	TSStack<int>::Container drained;
+	count = stack.drainAll(drained);
+	assert(count == 2);
+	assert(*drained.top() == 2);
+	assert(stack.empty());
+	count = stack.tryPopN(std::back_inserter(popped), 4);
+	assert(count == 0);
+
+	// Items stored by value in a vector
+	TSStack<int, int> valueStack;
+	valueStack.pushRange(items.begin(), items.end());
+	valueStack.push(7);
+	int item{0};
+	[[maybe_unused]] bool poppedItem = valueStack.tryPop(item);
+	assert(poppedItem && item == 7);
+	popped.clear();
+	count = valueStack.tryPopN(std::back_inserter(popped), 2);
+	assert(count == 2);
+	assert((popped == std::vector<int>{6, 5}));
+	TSStack<int, int>::Container valueDrained;
+	count = valueStack.drainAll(valueDrained);
+	assert(count == 4 && valueDrained.top() == 4);
+
 
 	return 0;
 }
\ No newline at end of file
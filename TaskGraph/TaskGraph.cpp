@@ -0,0 +1,105 @@
+#include "TaskGraph.hpp"
+#include <stdexcept>
+#include <cassert>
+
+// Make this node run before 'other'
+TaskGraph::Node& TaskGraph::Node::precede(Node& other) {
+	assert(m_graph == other.m_graph);
+	m_successors.push_back(&other);
+	++other.m_numPredecessors;
+	m_graph->m_validated = false;
+	return *this;
+}
+
+// Make this node run after 'other'
+TaskGraph::Node& TaskGraph::Node::succeed(Node& other) {
+	other.precede(*this);
+	return *this;
+}
+
+// Run every node once and wait until all of them have finished
+void TaskGraph::run(WSThreadPool& pool) {
+	if (!m_validated)
+		validate();
+	if (m_nodes.empty())
+		return;
+	for (auto& node : m_nodes)
+		node.m_pending.store(node.m_numPredecessors, std::memory_order_relaxed);
+	m_remaining.store(m_nodes.size(), std::memory_order_relaxed);
+	m_done = false;
+	// Posting publishes the stores above to the threads that run the nodes
+	for (Node* source : m_sources)
+		post(pool, source);
+	// Help while the nodes run if the calling thread is a worker
+	if (pool.isWorkerThread()) {
+		while (m_remaining.load(std::memory_order_acquire) != 0)
+			pool.runPendingTask();
+	}
+	std::unique_lock lock{m_mutex};
+	m_cond.wait(lock, [this]() { return m_done; });
+}
+
+// Check that the graph is acyclic (Kahn's algorithm) and collect the sources
+void TaskGraph::validate() {
+	m_sources.clear();
+	std::vector<size_t> pending;
+	std::vector<Node*> ready;
+	pending.reserve(m_nodes.size());
+	for (auto& node : m_nodes) {
+		if (node.m_numPredecessors == 0) {
+			m_sources.push_back(&node);
+			ready.push_back(&node);
+		}
+	}
+	// Remaining predecessor counts are kept in m_pending while checking
+	for (auto& node : m_nodes)
+		node.m_pending.store(node.m_numPredecessors, std::memory_order_relaxed);
+	size_t visited = 0;
+	while (!ready.empty()) {
+		Node* node = ready.back();
+		ready.pop_back();
+		++visited;
+		for (Node* successor : node->m_successors) {
+			if (successor->m_pending.fetch_sub(1, std::memory_order_relaxed) == 1)
+				ready.push_back(successor);
+		}
+	}
+	if (visited != m_nodes.size())
+		throw std::invalid_argument("TaskGraph has a cycle");
+	m_validated = true;
+}
+
+// Run a node and then every successor that it makes ready on the calling thread
+void TaskGraph::execute(WSThreadPool& pool, Node* node) {
+	while (node) {
+		node->m_work();
+		// Keep the first successor that became ready and hand the others to the pool
+		Node* next = nullptr;
+		for (Node* successor : node->m_successors) {
+			if (successor->m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				if (!next)
+					next = successor;
+				else
+					post(pool, successor);
+			}
+		}
+		finishNode();
+		node = next;
+	}
+}
+
+// Post a node to the pool through its own TaskNode
+// A node is posted at most once per run and its task is moved out when a worker takes it, so the TaskNode is free for the next run
+void TaskGraph::post(WSThreadPool& pool, Node* node) {
+	node->m_taskNode.task = Task([this, &pool, node]() { execute(pool, node); });
+	pool.postNode(&node->m_taskNode);
+}
+
+// Count a finished node and signal the end of the run after the last one
+void TaskGraph::finishNode() {
+	if (m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		std::scoped_lock lock{m_mutex};
+		m_done = true;
+		m_cond.notify_all();
+	}
+}
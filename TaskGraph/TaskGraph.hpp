@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include "WSThreadPool.hpp"
+
+// Directed acyclic graph of tasks executed on a WSThreadPool
+// Every node counts its unfinished predecessors with an atomic counter. The worker that finishes
+// a node's last predecessor runs the node itself, so chains run without going through a queue.
+// Other nodes that become ready at the same time are pushed to that worker's deque where idle workers can steal them
+// The graph is built once and can be run many times without allocating: every node embeds the TaskNode that carries it
+// through the pool's queues, and the pool's main queue reuses its slots once it has grown to hold the sources
+/* Usage:
+TaskGraph graph;
+auto& a = graph.emplace([]() { ... });
+auto& b = graph.emplace([]() { ... });
+auto& c = graph.emplace([]() { ... });
+a.precede(b).precede(c); // b and c run after a
+graph.run(pool);
+*/
+class TaskGraph
+{
+public:
+	class Node
+	{
+		friend class TaskGraph;
+	private:
+		TaskGraph* m_graph;
+		Task m_work; // Invoked once per run
+		TaskNode m_taskNode; // Posted to the pool when the node becomes ready. Free again once a worker has taken it
+		std::vector<Node*> m_successors;
+		size_t m_numPredecessors{ 0 };
+		std::atomic<size_t> m_pending{ 0 }; // Predecessors that have not finished in the current run
+	public:
+		Node(TaskGraph* graph, Task&& work) : m_graph(graph), m_work(std::move(work)) {}
+		Node(const Node&) = delete;
+		Node& operator=(const Node&) = delete;
+		// Make this node run before 'other'. Both nodes must belong to the same graph
+		Node& precede(Node& other);
+		// Make this node run after 'other'. Both nodes must belong to the same graph
+		Node& succeed(Node& other);
+		size_t numSuccessors() const { return m_successors.size(); }
+		size_t numPredecessors() const { return m_numPredecessors; }
+	};
+private:
+	std::deque<Node> m_nodes; // A deque keeps the addresses of nodes stable
+	std::vector<Node*> m_sources; // Nodes without predecessors
+	bool m_validated{ false }; // Set once the current structure has been checked for cycles
+	std::atomic<size_t> m_remaining{ 0 }; // Nodes that have not finished in the current run
+	// Signals the end of a run. The last node notifies under the mutex so that the graph can be destroyed right after run()
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	bool m_done{ false };
+public:
+	TaskGraph() = default;
+	TaskGraph(const TaskGraph&) = delete;
+	TaskGraph& operator=(const TaskGraph&) = delete;
+	// Add a node that invokes func. The callable must not throw
+	template <class Func>
+	Node& emplace(Func func);
+	// Run every node once, respecting the edges, and wait until all of them have finished
+	// A worker of the pool runs other tasks while it waits
+	// Throws std::invalid_argument if the graph has a cycle. Must not be called concurrently on the same graph
+	void run(WSThreadPool& pool);
+	size_t size() const { return m_nodes.size(); }
+private:
+	// Check that the graph is acyclic and collect the sources
+	void validate();
+	// Run a node and then every successor that it makes ready on the calling thread
+	void execute(WSThreadPool& pool, Node* node);
+	// Post a node to the pool through its own TaskNode
+	void post(WSThreadPool& pool, Node* node);
+	// Count a finished node and signal the end of the run after the last one
+	void finishNode();
+};
+
+// Add a node that invokes func
+template <class Func>
+TaskGraph::Node& TaskGraph::emplace(Func func) {
+	m_validated = false;
+	return m_nodes.emplace_back(this, Task(std::move(func)));
+}
@@ -0,0 +1,114 @@
+#include "AllocationCounter.hpp"
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+
+std::atomic<size_t> allocations{0};
+
+// Every form of operator new and delete is replaced, so that each allocation is counted
+// and each pointer is released by the function that matches the one that made it
+
+static void* allocate(size_t size) noexcept {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	return std::malloc(size ? size : 1);
+}
+
+// Over-allocate and keep the pointer returned by malloc just below the aligned block, so that aligned delete can free it
+static void* allocateAligned(size_t size, std::align_val_t alignment) noexcept {
+	auto align = static_cast<size_t>(alignment);
+	void* raw = allocate(size + align + sizeof(void*));
+	if (!raw)
+		return nullptr;
+	auto address = (reinterpret_cast<std::uintptr_t>(raw) + sizeof(void*) + align - 1) & ~static_cast<std::uintptr_t>(align - 1);
+	reinterpret_cast<void**>(address)[-1] = raw;
+	return reinterpret_cast<void*>(address);
+}
+
+static void freeAligned(void* ptr) noexcept {
+	if (ptr)
+		std::free(static_cast<void**>(ptr)[-1]);
+}
+
+void* operator new(size_t size) {
+	if (void* ptr = allocate(size))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+	return ::operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	return allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+	return allocate(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+	if (void* ptr = allocateAligned(size, alignment))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+	return ::operator new(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	return allocateAligned(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	return allocateAligned(size, alignment);
+}
+
+void operator delete(void* ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+	freeAligned(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+	freeAligned(ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept {
+	freeAligned(ptr);
+}
+
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept {
+	freeAligned(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept {
+	freeAligned(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept {
+	freeAligned(ptr);
+}
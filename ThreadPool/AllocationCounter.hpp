@@ -0,0 +1,8 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+// Heap allocations made by the whole program, counted by the replacement operator new and delete in AllocationCounter.cpp
+// A demo that reads it adds AllocationCounter.cpp to its project. The replacements live in their own translation unit,
+// so the compiler never inlines a malloc-backed delete next to the operator new it sees as the library's
+extern std::atomic<size_t> allocations;
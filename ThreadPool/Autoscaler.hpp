@@ -0,0 +1,81 @@
+#pragma once
+#include <thread>
+#include <stop_token>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+
+// When an autoscaling pool adds and retires workers
+struct ScalingPolicy
+{
+	size_t minThreads{ 1 };
+	size_t maxThreads{ std::max(std::thread::hardware_concurrency(), 1u) };
+	// Add a worker when more than this many tasks per worker are queued
+	size_t growQueueDepth{ 8 };
+	// Add a worker when the oldest queued task has waited longer than this (pools that track it)
+	std::chrono::microseconds growWaitTime{ 2000 };
+	// Retire a worker when some worker has been parked for this long
+	std::chrono::milliseconds idleTimeout{ 1000 };
+	// How often the load is sampled
+	std::chrono::milliseconds interval{ 10 };
+};
+
+// Thread that samples the load of a pool and resizes it according to a ScalingPolicy
+// Adds one worker per sample while the pool is overloaded and retires one per idle timeout
+// Pool must provide getNumThreads(), resize(), queueSize() and numIdleWorkers(), and may provide oldestTaskWait()
+template <class Pool>
+class Autoscaler
+{
+private:
+	using Clock = std::chrono::steady_clock;
+	Pool& m_pool;
+	ScalingPolicy m_policy;
+	std::jthread m_thread; // Declared last so that it starts after the other members are initialized
+public:
+	Autoscaler(Pool& pool, ScalingPolicy policy) : m_pool(pool), m_policy(policy), m_thread(std::bind_front(&Autoscaler::run, this)) {}
+	Autoscaler(const Autoscaler&) = delete;
+	Autoscaler& operator=(const Autoscaler&) = delete;
+	// The jthread destructor stops and joins the sampling thread
+private:
+	void run(std::stop_token token);
+	bool isOverloaded(size_t numThreads) const;
+};
+
+template <class Pool>
+void Autoscaler<Pool>::run(std::stop_token token) {
+	std::mutex mutex;
+	std::condition_variable_any cond;
+	auto busySince = Clock::now(); // Last sample without a parked worker
+	std::unique_lock lock{mutex};
+	while (!token.stop_requested()) {
+		// Sleep for one interval or until the stop request
+		cond.wait_for(lock, token, m_policy.interval, []() { return false; });
+		if (token.stop_requested())
+			break;
+		auto now = Clock::now();
+		size_t numThreads = m_pool.getNumThreads();
+		if (isOverloaded(numThreads)) {
+			if (numThreads < m_policy.maxThreads)
+				m_pool.resize(numThreads + 1);
+			busySince = now;
+		}
+		else if (m_pool.numIdleWorkers() == 0)
+			busySince = now;
+		else if (now - busySince >= m_policy.idleTimeout) {
+			if (numThreads > m_policy.minThreads)
+				m_pool.resize(numThreads - 1);
+			busySince = now;
+		}
+	}
+}
+
+template <class Pool>
+bool Autoscaler<Pool>::isOverloaded(size_t numThreads) const {
+	if (m_pool.queueSize() > m_policy.growQueueDepth * numThreads)
+		return true;
+	if constexpr (requires { m_pool.oldestTaskWait(); })
+		return m_pool.oldestTaskWait() > m_policy.growWaitTime;
+	return false;
+}
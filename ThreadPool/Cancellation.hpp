@@ -0,0 +1,66 @@
+#pragma once
+#include <future>
+#include <stop_token>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+// Exception stored in the future of a task that was cancelled before it started
+class TaskCancelled : public std::runtime_error
+{
+public:
+	TaskCancelled() : std::runtime_error("task cancelled") {}
+};
+
+// Result of a callable that may take the stop token of its task
+template <class Func>
+using CancellableResult = typename std::conditional_t<std::is_invocable_v<Func&, std::stop_token>,
+	std::invoke_result<Func&, std::stop_token>, std::invoke_result<Func&>>::type;
+
+// Callable that runs 'func' unless stop has been requested on its token by the time a worker dequeues it
+// A cancelled task is discarded without running and its future gets TaskCancelled
+// 'func' is invoked with the token if it accepts one, so that a long running task can also stop cooperatively
+// One std::stop_source can cancel a group of tasks by handing its token to each of them
+template <class Func>
+class CancellableTask
+{
+public:
+	using ResultType = CancellableResult<Func>;
+private:
+	Func m_func;
+	std::stop_token m_token;
+	std::promise<ResultType> m_promise;
+public:
+	CancellableTask(Func func, std::stop_token token) : m_func(std::move(func)), m_token(std::move(token)) {}
+	std::future<ResultType> getFuture() { return m_promise.get_future(); }
+	void operator()();
+private:
+	ResultType invoke();
+};
+
+template <class Func>
+void CancellableTask<Func>::operator()() {
+	if (m_token.stop_requested()) {
+		m_promise.set_exception(std::make_exception_ptr(TaskCancelled{}));
+		return;
+	}
+	try {
+		if constexpr (std::is_void_v<ResultType>) {
+			invoke();
+			m_promise.set_value();
+		}
+		else
+			m_promise.set_value(invoke());
+	}
+	catch (...) {
+		m_promise.set_exception(std::current_exception());
+	}
+}
+
+template <class Func>
+typename CancellableTask<Func>::ResultType CancellableTask<Func>::invoke() {
+	if constexpr (std::is_invocable_v<Func&, std::stop_token>)
+		return m_func(m_token);
+	else
+		return m_func();
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <thread>
+#include <stop_token>
+#include <chrono>
+#include "EventCount.hpp"
+#include "Metrics.hpp"
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Idle policy for pool workers that found no task
+// 1. Spin 'spinCount' times with a pause instruction (lowest wakeup latency)
+// 2. Yield 'yieldCount' times to let other threads run
+// 3. Park on an EventCount until a task is submitted (no CPU usage)
+// IdleStrategy{ .park = false } keeps yielding forever and never parks
+struct IdleStrategy
+{
+	unsigned spinCount{ 64 };
+	unsigned yieldCount{ 16 };
+	bool park{ true };
+};
+
+// Hint the CPU that the current thread is spinning
+inline void cpuRelax() {
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	_mm_pause();
+#else
+	std::this_thread::yield();
+#endif
+}
+
+// Per-worker state machine that applies an IdleStrategy
+// Call idle() after every failed attempt to get a task and reset() after every successful one
+// If 'counters' is given, the time spent in each phase is added to it. The clock is only read when the phase changes
+class Idler
+{
+	using Clock = std::chrono::steady_clock;
+	enum class Phase { Busy, Spin, Yield, Park };
+	const IdleStrategy& m_strategy;
+	EventCount& m_event;
+	WorkerCounters* m_counters;
+	unsigned m_rounds{ 0 };
+	Phase m_phase{ Phase::Busy };
+	Clock::time_point m_phaseStart;
+public:
+	Idler(const IdleStrategy& strategy, EventCount& event, WorkerCounters* counters = nullptr) : m_strategy(strategy), m_event(event), m_counters(counters) {}
+	void reset() {
+		m_rounds = 0;
+		enter(Phase::Busy);
+	}
+	// Back off once. 'hasWork' is re-checked before parking so that a task pushed meanwhile is not missed
+	template <class Pred>
+	void idle(Pred hasWork, const std::stop_token& token) {
+		if (m_rounds < m_strategy.spinCount) {
+			enter(Phase::Spin);
+			++m_rounds;
+			cpuRelax();
+		}
+		else if (m_rounds < m_strategy.spinCount + m_strategy.yieldCount || !m_strategy.park) {
+			enter(Phase::Yield);
+			++m_rounds;
+			std::this_thread::yield();
+		}
+		else {
+			enter(Phase::Park);
+			auto key = m_event.prepareWait();
+			if (hasWork() || token.stop_requested())
+				m_event.cancelWait();
+			else
+				m_event.wait(key);
+			m_rounds = 0;
+		}
+	}
+private:
+	// Charge the time since the last phase change to the phase that ends
+	void enter(Phase phase) {
+		if (!m_counters || phase == m_phase)
+			return;
+		auto now = Clock::now();
+		auto elapsed = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_phaseStart).count());
+		switch (m_phase) {
+		case Phase::Spin: bumpCounter(m_counters->spinTime, elapsed); break;
+		case Phase::Yield: bumpCounter(m_counters->yieldTime, elapsed); break;
+		case Phase::Park: bumpCounter(m_counters->parkTime, elapsed); break;
+		default: break;
+		}
+		if (phase == Phase::Park)
+			bumpCounter(m_counters->parks);
+		m_phase = phase;
+		m_phaseStart = now;
+	}
+};
@@ -0,0 +1,170 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <bit>
+#include <algorithm>
+
+// Increment a counter that only one thread writes
+// A relaxed load and store instead of fetch_add, so that the owner pays no locked instruction and readers still see whole values
+inline void bumpCounter(std::atomic<uint64_t>& counter, uint64_t amount = 1) {
+	counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+// Log-linear bucketing of durations in nanoseconds, as in HDR histograms
+// Durations below 8ns have a bucket each. Above that, every power of two is split into 8 buckets,
+// so a bucket's bounds are within 12.5% of each other. Durations of 2^40ns (about 18 minutes) and more share the last bucket
+struct HistogramBuckets
+{
+	static constexpr unsigned subBucketBits{ 3 };
+	static constexpr size_t subBuckets{ size_t{1} << subBucketBits };
+	static constexpr unsigned maxBits{ 40 };
+	static constexpr size_t count{ (maxBits - subBucketBits + 1) * subBuckets };
+	static size_t indexOf(uint64_t ns) {
+		if (ns < subBuckets)
+			return static_cast<size_t>(ns);
+		unsigned msb = static_cast<unsigned>(std::bit_width(ns)) - 1;
+		if (msb >= maxBits)
+			return count - 1;
+		return (msb - subBucketBits + 1) * subBuckets + ((ns >> (msb - subBucketBits)) & (subBuckets - 1));
+	}
+	// Smallest duration that falls in the bucket
+	static uint64_t lowerBound(size_t index) {
+		if (index < subBuckets)
+			return index;
+		unsigned msb = static_cast<unsigned>(index / subBuckets) + subBucketBits - 1;
+		return (subBuckets + index % subBuckets) << (msb - subBucketBits);
+	}
+};
+
+// Histogram of durations. Plain copyable values, as aggregated by a metrics snapshot
+class LatencyHistogram
+{
+private:
+	std::array<uint64_t, HistogramBuckets::count> m_counts{};
+	uint64_t m_count{ 0 };
+	uint64_t m_max{ 0 }; // Lower bound of the highest non-empty bucket
+public:
+	void add(size_t bucket, uint64_t count);
+	void merge(const LatencyHistogram& other);
+	uint64_t count() const { return m_count; }
+	// Duration that 'fraction' (0 to 1) of the recorded durations do not exceed, to within the bucket's 12.5%
+	std::chrono::nanoseconds percentile(double fraction) const;
+	std::chrono::nanoseconds max() const { return std::chrono::nanoseconds(m_max); }
+};
+
+// Histogram that one thread records to while others copy it
+// Recording is a bucket lookup and a relaxed store, with no locked instruction
+class LatencyRecorder
+{
+private:
+	std::array<std::atomic<uint64_t>, HistogramBuckets::count> m_counts{};
+public:
+	// Owner only
+	void record(std::chrono::nanoseconds duration) {
+		bumpCounter(m_counts[HistogramBuckets::indexOf(static_cast<uint64_t>(std::max<int64_t>(duration.count(), 0)))]);
+	}
+	// Add the recorded durations to 'histogram'. May run concurrently with record()
+	void addTo(LatencyHistogram& histogram) const;
+};
+
+// Counters of one worker. Only the worker writes them, snapshots read them
+struct alignas(64) WorkerCounters
+{
+	std::atomic<uint64_t> tasksExecuted{ 0 };
+	// Nanoseconds spent in each phase of the IdleStrategy, and how many times the worker parked
+	// A phase is counted when it ends, so a worker that is still parked has not added its current park yet
+	std::atomic<uint64_t> spinTime{ 0 };
+	std::atomic<uint64_t> yieldTime{ 0 };
+	std::atomic<uint64_t> parkTime{ 0 };
+	std::atomic<uint64_t> parks{ 0 };
+	// Recorded while task timing is enabled
+	LatencyRecorder queueWait; // From submission until a worker took the task
+	LatencyRecorder runTime;
+};
+
+// Metrics of one worker at the time of a snapshot
+struct WorkerMetrics
+{
+	uint64_t tasksExecuted{ 0 };
+	size_t queueDepth{ 0 }; // Tasks in the worker's own queue. Always 0 for pools with a central queue
+	uint64_t stealAttempts{ 0 };
+	uint64_t stealSuccesses{ 0 };
+	uint64_t tasksStolen{ 0 };
+	std::chrono::nanoseconds spinTime{ 0 };
+	std::chrono::nanoseconds yieldTime{ 0 };
+	std::chrono::nanoseconds parkTime{ 0 };
+	uint64_t parks{ 0 };
+	// Add the counters of a worker. queueDepth and the steal counters are filled in by the pool
+	void addCounters(const WorkerCounters& counters);
+};
+
+// Metrics of a pool, aggregated from the per-worker counters by snapshot()
+// The counters are read one at a time while the workers run, so a snapshot is not an atomic cut of the pool
+struct PoolMetrics
+{
+	std::vector<WorkerMetrics> workers; // One per worker slot, including retired workers of a resized pool
+	std::vector<size_t> injectorDepth; // Tasks in each queue that submissions from outside the pool go to
+	LatencyHistogram queueWait;
+	LatencyHistogram runTime;
+	// Sum over all workers
+	WorkerMetrics total() const;
+};
+
+inline void LatencyHistogram::add(size_t bucket, uint64_t count) {
+	if (count == 0)
+		return;
+	m_counts[bucket] += count;
+	m_count += count;
+	m_max = std::max(m_max, HistogramBuckets::lowerBound(bucket));
+}
+
+inline void LatencyHistogram::merge(const LatencyHistogram& other) {
+	for (size_t bucket = 0; bucket < HistogramBuckets::count; ++bucket)
+		add(bucket, other.m_counts[bucket]);
+}
+
+inline std::chrono::nanoseconds LatencyHistogram::percentile(double fraction) const {
+	if (m_count == 0)
+		return std::chrono::nanoseconds(0);
+	auto rank = static_cast<uint64_t>(std::clamp(fraction, 0.0, 1.0) * static_cast<double>(m_count - 1)) + 1;
+	uint64_t seen = 0;
+	for (size_t bucket = 0; bucket < HistogramBuckets::count; ++bucket) {
+		seen += m_counts[bucket];
+		if (seen >= rank)
+			return std::chrono::nanoseconds(HistogramBuckets::lowerBound(bucket));
+	}
+	return max();
+}
+
+inline void LatencyRecorder::addTo(LatencyHistogram& histogram) const {
+	for (size_t bucket = 0; bucket < HistogramBuckets::count; ++bucket)
+		histogram.add(bucket, m_counts[bucket].load(std::memory_order_relaxed));
+}
+
+inline void WorkerMetrics::addCounters(const WorkerCounters& counters) {
+	tasksExecuted += counters.tasksExecuted.load(std::memory_order_relaxed);
+	spinTime += std::chrono::nanoseconds(counters.spinTime.load(std::memory_order_relaxed));
+	yieldTime += std::chrono::nanoseconds(counters.yieldTime.load(std::memory_order_relaxed));
+	parkTime += std::chrono::nanoseconds(counters.parkTime.load(std::memory_order_relaxed));
+	parks += counters.parks.load(std::memory_order_relaxed);
+}
+
+inline WorkerMetrics PoolMetrics::total() const {
+	WorkerMetrics sum;
+	for (const auto& worker : workers) {
+		sum.tasksExecuted += worker.tasksExecuted;
+		sum.queueDepth += worker.queueDepth;
+		sum.stealAttempts += worker.stealAttempts;
+		sum.stealSuccesses += worker.stealSuccesses;
+		sum.tasksStolen += worker.tasksStolen;
+		sum.spinTime += worker.spinTime;
+		sum.yieldTime += worker.yieldTime;
+		sum.parkTime += worker.parkTime;
+		sum.parks += worker.parks;
+	}
+	return sum;
+}
@@ -0,0 +1,266 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <limits>
+#include <chrono>
+#include <algorithm>
+#include "Task.hpp"
+#include "RingQueue.hpp"
+
+// Priority class of a task
+enum class Priority { High, Normal, Low };
+
+// Guarantees that keep lower lanes and deadline tasks from starving behind higher lanes
+struct AgingPolicy
+{
+	// A non-empty lane is served at least once per period, even while higher lanes have tasks
+	std::chrono::microseconds normalPeriod{ 1000 };
+	std::chrono::microseconds lowPeriod{ 10000 };
+	// A task with a deadline is served ahead of every lane once its deadline is this close
+	std::chrono::microseconds deadlineLead{ 1000 };
+};
+
+// What a push does when the queue is full
+enum class OverflowPolicy
+{
+	Block, // Wait until a worker takes a task. Waiting does not spin
+	RunInline, // Fail, so that the caller runs the task itself
+	DropOldest // Destroy the oldest task of the lowest non-empty lane to make room. With only deadline tasks queued, the one queued first
+};
+
+// Capacity of a task queue
+struct QueueBound
+{
+	size_t capacity{ 0 }; // 0 means unbounded
+	OverflowPolicy overflow{ OverflowPolicy::Block };
+};
+
+// Task queue with a FIFO lane per priority and a lane ordered by deadline
+// tryPop() serves, in order:
+// 1. The earliest deadline task if its deadline is within AgingPolicy::deadlineLead
+// 2. The head of a Normal or Low lane that has not been served for its period (aging)
+// 3. The head of the highest non-empty lane. Deadline tasks that are not urgent yet rank between Normal and Low
+class PriorityLanes
+{
+public:
+	using Clock = std::chrono::steady_clock;
+private:
+	struct Entry {
+		Task task;
+		Clock::time_point enqueued;
+	};
+	struct DeadlineEntry {
+		Task task;
+		Clock::time_point deadline;
+		Clock::time_point enqueued;
+	};
+	// Orders the deadline heap so that the earliest deadline is on top
+	struct LaterDeadline {
+		bool operator()(const DeadlineEntry& a, const DeadlineEntry& b) const { return a.deadline > b.deadline; }
+	};
+	static constexpr size_t numLanes{3};
+	mutable std::mutex m_mutex;
+	std::condition_variable m_notFull; // Pushers blocked by a full queue wait on this
+	AgingPolicy m_policy;
+	QueueBound m_bound;
+	size_t m_size{ 0 }; // Tasks in all lanes
+	size_t m_blockedPushers{ 0 };
+	std::array<RingQueue<Entry>, numLanes> m_lanes; // Indexed by Priority. Ring buffers, so a push does not allocate once a lane has grown to its peak
+	std::array<Clock::time_point, numLanes> m_lastServed{}; // When each lane last had a task popped
+	std::vector<DeadlineEntry> m_deadlines; // Heap of tasks with a deadline
+public:
+	explicit PriorityLanes(AgingPolicy policy = {}, QueueBound bound = {})
+		: m_policy(policy), m_bound{ bound.capacity ? bound.capacity : std::numeric_limits<size_t>::max(), bound.overflow } {}
+	PriorityLanes(const PriorityLanes&) = delete;
+	PriorityLanes& operator=(const PriorityLanes&) = delete;
+	// Push a task. If the queue is full, apply the overflow policy
+	// Returns false and leaves 'task' untouched if the task was not queued: the queue is full and the policy is RunInline,
+	// or the policy is Block and 'mayWait' is false
+	bool push(Task& task, Priority priority, bool mayWait = true);
+	// Push a task only if there is room. Never waits or drops a task
+	bool tryPush(Task& task, Priority priority);
+	bool pushDeadline(Task& task, Clock::time_point deadline, bool mayWait = true);
+	// Push as many of the tasks, in order, as there is room for under one lock acquisition. Never waits
+	// DropOldest makes room by dropping older tasks, but never tasks of the same range
+	// Returns the number of tasks queued. The tasks that were queued are moved from, the rest are untouched
+	size_t pushRange(std::vector<Task>& tasks, Priority priority);
+	// 'waited', if given, receives how long the popped task was queued
+	bool tryPop(Task& result, Clock::duration* waited = nullptr);
+	bool empty() const;
+	size_t size() const;
+	// Number of tasks in each lane, indexed by Priority, followed by the number of tasks with a deadline
+	std::array<size_t, 4> laneSizes() const;
+	// How long the oldest task in the priority lanes has been queued. Tasks with a deadline are not included
+	Clock::duration oldestWait() const;
+private:
+	// Make room for 'count' more tasks according to the overflow policy. The lock must be held
+	// Returns the number of tasks there is room for, at most 'count'. Dropped tasks are moved to 'dropped'
+	size_t makeRoom(std::unique_lock<std::mutex>& lock, size_t count, bool mayWait, std::vector<Task>& dropped);
+	// Wake a pusher blocked by a full queue after a task was taken. The lock must be held
+	void notifyNotFull();
+	// Pop the head of a lane. The lock must be held. Returns when the task was queued
+	Clock::time_point popLane(size_t lane, Clock::time_point now, Task& result);
+	// Pop the earliest deadline task. The lock must be held. Returns when the task was queued
+	Clock::time_point popDeadline(Task& result);
+};
+
+inline bool PriorityLanes::push(Task& task, Priority priority, bool mayWait) {
+	auto now = Clock::now();
+	std::vector<Task> dropped; // Destroyed after the lock is released
+	std::unique_lock lock{m_mutex};
+	if (makeRoom(lock, 1, mayWait, dropped) == 0)
+		return false;
+	m_lanes[static_cast<size_t>(priority)].push_back(Entry{ std::move(task), now });
+	++m_size;
+	return true;
+}
+
+inline bool PriorityLanes::tryPush(Task& task, Priority priority) {
+	auto now = Clock::now();
+	std::scoped_lock lock{m_mutex};
+	if (m_size >= m_bound.capacity)
+		return false;
+	m_lanes[static_cast<size_t>(priority)].push_back(Entry{ std::move(task), now });
+	++m_size;
+	return true;
+}
+
+inline bool PriorityLanes::pushDeadline(Task& task, Clock::time_point deadline, bool mayWait) {
+	auto now = Clock::now();
+	std::vector<Task> dropped;
+	std::unique_lock lock{m_mutex};
+	if (makeRoom(lock, 1, mayWait, dropped) == 0)
+		return false;
+	m_deadlines.push_back(DeadlineEntry{ std::move(task), deadline, now });
+	std::push_heap(m_deadlines.begin(), m_deadlines.end(), LaterDeadline{});
+	++m_size;
+	return true;
+}
+
+inline size_t PriorityLanes::pushRange(std::vector<Task>& tasks, Priority priority) {
+	auto now = Clock::now();
+	std::vector<Task> dropped;
+	std::unique_lock lock{m_mutex};
+	size_t room = makeRoom(lock, tasks.size(), false, dropped);
+	auto& lane = m_lanes[static_cast<size_t>(priority)];
+	for (size_t i = 0; i < room; ++i)
+		lane.push_back(Entry{ std::move(tasks[i]), now });
+	m_size += room;
+	return room;
+}
+
+inline bool PriorityLanes::tryPop(Task& result, Clock::duration* waited) {
+	constexpr auto high = static_cast<size_t>(Priority::High);
+	constexpr auto normal = static_cast<size_t>(Priority::Normal);
+	constexpr auto low = static_cast<size_t>(Priority::Low);
+	auto now = Clock::now();
+	std::scoped_lock lock{m_mutex};
+	if (m_size == 0)
+		return false;
+	Clock::time_point enqueued;
+	if (!m_deadlines.empty() && m_deadlines.front().deadline <= now + m_policy.deadlineLead)
+		enqueued = popDeadline(result);
+	else if (!m_lanes[normal].empty() && now - m_lastServed[normal] >= m_policy.normalPeriod)
+		enqueued = popLane(normal, now, result);
+	else if (!m_lanes[low].empty() && now - m_lastServed[low] >= m_policy.lowPeriod)
+		enqueued = popLane(low, now, result);
+	else if (!m_lanes[high].empty())
+		enqueued = popLane(high, now, result);
+	else if (!m_lanes[normal].empty())
+		enqueued = popLane(normal, now, result);
+	else if (!m_deadlines.empty())
+		enqueued = popDeadline(result);
+	else
+		enqueued = popLane(low, now, result);
+	if (waited)
+		*waited = now - enqueued;
+	--m_size;
+	notifyNotFull();
+	return true;
+}
+
+inline bool PriorityLanes::empty() const {
+	std::scoped_lock lock{m_mutex};
+	return m_size == 0;
+}
+
+inline size_t PriorityLanes::size() const {
+	std::scoped_lock lock{m_mutex};
+	return m_size;
+}
+
+inline std::array<size_t, 4> PriorityLanes::laneSizes() const {
+	std::scoped_lock lock{m_mutex};
+	return { m_lanes[0].size(), m_lanes[1].size(), m_lanes[2].size(), m_deadlines.size() };
+}
+
+inline PriorityLanes::Clock::duration PriorityLanes::oldestWait() const {
+	auto now = Clock::now();
+	std::scoped_lock lock{m_mutex};
+	Clock::duration oldest{ 0 };
+	for (const auto& lane : m_lanes) {
+		if (!lane.empty())
+			oldest = std::max(oldest, now - lane.front().enqueued);
+	}
+	return oldest;
+}
+
+inline size_t PriorityLanes::makeRoom(std::unique_lock<std::mutex>& lock, size_t count, bool mayWait, std::vector<Task>& dropped) {
+	if (m_size < m_bound.capacity)
+		return std::min(count, m_bound.capacity - m_size);
+	switch (m_bound.overflow) {
+	case OverflowPolicy::Block:
+		if (!mayWait)
+			return 0;
+		++m_blockedPushers;
+		m_notFull.wait(lock, [this]() { return m_size < m_bound.capacity; });
+		--m_blockedPushers;
+		return std::min(count, m_bound.capacity - m_size);
+	case OverflowPolicy::DropOldest:
+		// The queue is full, so dropping n tasks makes room for n
+		count = std::min(count, m_bound.capacity);
+		for (size_t i = 0; i < count; ++i) {
+			auto lane = std::find_if(m_lanes.rbegin(), m_lanes.rend(), [](const auto& lane) { return !lane.empty(); });
+			if (lane != m_lanes.rend()) {
+				dropped.push_back(std::move(lane->front().task));
+				lane->pop_front();
+			}
+			else {
+				// Drop by enqueue time. The top of the heap is the most urgent task, not the oldest
+				auto oldest = std::min_element(m_deadlines.begin(), m_deadlines.end(),
+					[](const DeadlineEntry& a, const DeadlineEntry& b) { return a.enqueued < b.enqueued; });
+				dropped.push_back(std::move(oldest->task));
+				*oldest = std::move(m_deadlines.back());
+				m_deadlines.pop_back();
+				std::make_heap(m_deadlines.begin(), m_deadlines.end(), LaterDeadline{});
+			}
+			--m_size;
+		}
+		return count;
+	default:
+		return 0;
+	}
+}
+
+inline void PriorityLanes::notifyNotFull() {
+	if (m_blockedPushers > 0)
+		m_notFull.notify_one();
+}
+
+inline PriorityLanes::Clock::time_point PriorityLanes::popLane(size_t lane, Clock::time_point now, Task& result) {
+	auto enqueued = m_lanes[lane].front().enqueued;
+	result = std::move(m_lanes[lane].front().task);
+	m_lanes[lane].pop_front();
+	m_lastServed[lane] = now;
+	return enqueued;
+}
+
+inline PriorityLanes::Clock::time_point PriorityLanes::popDeadline(Task& result) {
+	std::pop_heap(m_deadlines.begin(), m_deadlines.end(), LaterDeadline{});
+	auto enqueued = m_deadlines.back().enqueued;
+	result = std::move(m_deadlines.back().task);
+	m_deadlines.pop_back();
+	return enqueued;
+}
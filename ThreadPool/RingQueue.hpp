@@ -0,0 +1,59 @@
+#pragma once
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+// Unbounded FIFO in a circular buffer. Not thread-safe: the owner guards it with its own lock
+// The buffer doubles when it is full and never shrinks, so once a queue has reached its peak length
+// pushing and popping reuse the same slots and do not allocate, unlike std::deque which frees and allocates blocks as it moves
+// Popped slots keep a moved-from T until they are reused
+template <class T>
+class RingQueue
+{
+private:
+	std::vector<T> m_slots; // Size is 0 or a power of 2
+	size_t m_head{ 0 }; // Index of the front item
+	size_t m_size{ 0 };
+	void grow();
+public:
+	RingQueue() = default;
+	explicit RingQueue(size_t capacity) { reserve(capacity); }
+	bool empty() const { return m_size == 0; }
+	size_t size() const { return m_size; }
+	size_t capacity() const { return m_slots.size(); }
+	T& front() { return m_slots[m_head]; }
+	const T& front() const { return m_slots[m_head]; }
+	void push_back(T item);
+	void pop_front();
+	// Make room for at least 'capacity' items
+	void reserve(size_t capacity);
+};
+
+template <class T>
+void RingQueue<T>::push_back(T item) {
+	if (m_size == m_slots.size())
+		grow();
+	m_slots[(m_head + m_size) & (m_slots.size() - 1)] = std::move(item);
+	++m_size;
+}
+
+template <class T>
+void RingQueue<T>::pop_front() {
+	m_head = (m_head + 1) & (m_slots.size() - 1);
+	--m_size;
+}
+
+template <class T>
+void RingQueue<T>::reserve(size_t capacity) {
+	while (m_slots.size() < capacity)
+		grow();
+}
+
+template <class T>
+void RingQueue<T>::grow() {
+	std::vector<T> slots(m_slots.empty() ? 16 : 2 * m_slots.size());
+	for (size_t i = 0; i < m_size; ++i)
+		slots[i] = std::move(m_slots[(m_head + i) & (m_slots.size() - 1)]);
+	m_slots = std::move(slots);
+	m_head = 0;
+}
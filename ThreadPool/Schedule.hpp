@@ -0,0 +1,23 @@
+#pragma once
+#include <coroutine>
+
+// Awaitable returned by the schedule() method of the pools
+// co_await pool.schedule() suspends the calling coroutine and resumes it on a worker of the pool
+// Awaiting it on a worker of the same pool requeues the coroutine, which lets other tasks run first
+template <class Pool>
+class ScheduleAwaiter
+{
+	Pool& m_pool;
+public:
+	explicit ScheduleAwaiter(Pool& pool) : m_pool(pool) {}
+	bool await_ready() const noexcept { return false; }
+	// The handle fits in a Task, so scheduling does not allocate beyond what post() does
+	void await_suspend(std::coroutine_handle<> handle) {
+		// A pool whose workers run their own posts LIFO offers a FIFO queue for this, so that requeued coroutines take turns
+		if constexpr (requires { m_pool.postToMainQueue([]() {}); })
+			m_pool.postToMainQueue([handle]() { handle.resume(); });
+		else
+			m_pool.post([handle]() { handle.resume(); });
+	}
+	void await_resume() const noexcept {}
+};
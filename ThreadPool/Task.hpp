@@ -0,0 +1,104 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <memory>
+#include <utility>
+#include <type_traits>
+
+// Move-only type-erased callable with inline storage
+// A Task occupies one cache line (64 bytes)
+// Callables that fit in 'inlineSize' bytes and are nothrow move constructible are stored without a heap allocation
+// Unlike std::function, move-only callables such as std::packaged_task can be stored directly
+class Task
+{
+public:
+	static constexpr size_t inlineSize{ 64 - sizeof(void*) };
+private:
+	// Operations on the stored callable
+	struct VTable {
+		void (*invoke)(void* storage);
+		void (*relocate)(void* to, void* from) noexcept; // Move the callable to 'to' and destroy the one in 'from'
+		void (*destroy)(void* storage) noexcept;
+	};
+	template <class Func>
+	static constexpr bool fitsInline = sizeof(Func) <= inlineSize
+		&& alignof(Func) <= alignof(void*)
+		&& std::is_nothrow_move_constructible_v<Func>;
+	// VTable for callables stored in m_storage
+	template <class Func>
+	static constexpr VTable s_inlineVTable{
+		[](void* storage) { (*std::launder(static_cast<Func*>(storage)))(); },
+		[](void* to, void* from) noexcept {
+			Func* source = std::launder(static_cast<Func*>(from));
+			::new (to) Func(std::move(*source));
+			source->~Func();
+		},
+		[](void* storage) noexcept { std::launder(static_cast<Func*>(storage))->~Func(); }
+	};
+	// VTable for callables stored on the heap. m_storage holds the pointer
+	template <class Func>
+	static constexpr VTable s_heapVTable{
+		[](void* storage) { (**static_cast<Func**>(storage))(); },
+		[](void* to, void* from) noexcept { *static_cast<Func**>(to) = *static_cast<Func**>(from); },
+		[](void* storage) noexcept { delete *static_cast<Func**>(storage); }
+	};
+
+	alignas(void*) std::byte m_storage[inlineSize];
+	const VTable* m_vtable{ nullptr };
+public:
+	Task() noexcept = default;
+	// Store a callable that can be invoked with no arguments
+	template <class Func>
+		requires (!std::is_same_v<std::remove_cvref_t<Func>, Task> && std::is_invocable_v<std::decay_t<Func>&>)
+	Task(Func&& func);
+	Task(const Task&) = delete;
+	Task& operator=(const Task&) = delete;
+	Task(Task&& other) noexcept;
+	Task& operator=(Task&& other) noexcept;
+	~Task() { reset(); }
+	// Invoke the stored callable. The Task must not be empty
+	void operator()() { m_vtable->invoke(m_storage); }
+	// Check if the Task holds a callable
+	explicit operator bool() const noexcept { return m_vtable != nullptr; }
+	// Destroy the stored callable if any
+	void reset() noexcept;
+};
+
+template <class Func>
+	requires (!std::is_same_v<std::remove_cvref_t<Func>, Task> && std::is_invocable_v<std::decay_t<Func>&>)
+Task::Task(Func&& func) {
+	using Stored = std::decay_t<Func>;
+	if constexpr (fitsInline<Stored>) {
+		::new (static_cast<void*>(m_storage)) Stored(std::forward<Func>(func));
+		m_vtable = &s_inlineVTable<Stored>;
+	}
+	else {
+		::new (static_cast<void*>(m_storage)) Stored*(new Stored(std::forward<Func>(func)));
+		m_vtable = &s_heapVTable<Stored>;
+	}
+}
+
+inline Task::Task(Task&& other) noexcept : m_vtable(other.m_vtable) {
+	if (m_vtable) {
+		m_vtable->relocate(m_storage, other.m_storage);
+		other.m_vtable = nullptr;
+	}
+}
+
+inline Task& Task::operator=(Task&& other) noexcept {
+	if (this != &other) {
+		reset();
+		if (other.m_vtable) {
+			other.m_vtable->relocate(m_storage, other.m_storage);
+			m_vtable = std::exchange(other.m_vtable, nullptr);
+		}
+	}
+	return *this;
+}
+
+inline void Task::reset() noexcept {
+	if (m_vtable) {
+		m_vtable->destroy(m_storage);
+		m_vtable = nullptr;
+	}
+}
@@ -1,15 +1,19 @@
 #include "ThreadPool.hpp"
 
 // Constructor: Initialize the thread pool with a specified number of threads
-ThreadPool::ThreadPool(size_t numThreads)
-	: m_numThreads(numThreads)
+ThreadPool::ThreadPool(size_t numThreads, IdleStrategy idleStrategy, AgingPolicy agingPolicy, Placement placement, QueueBound queueBound,
+	QueueBackend backend)
+	: m_numThreads(numThreads), m_queue(agingPolicy, queueBound), m_overflow(queueBound.overflow), m_idleStrategy(idleStrategy)
 {
+	if (backend == QueueBackend::Ring)
+		m_ring = std::make_unique<MPMCQueue<RingEntry>>(queueBound.capacity ? queueBound.capacity : 4096);
+	if (placement.pinWorkers)
+		m_cpus = CpuTopology::detect().placementOrder();
 	try
 	{	
 		m_threads.reserve(numThreads);
-		for (size_t i = 0; i < m_numThreads; ++i) {
-			m_threads.emplace_back(std::bind_front(&ThreadPool::work, this));
-		}
+		for (size_t i = 0; i < m_numThreads; ++i)
+			startWorker();
 	}
 	catch (const std::exception&)
 	{
@@ -20,26 +24,207 @@ ThreadPool::ThreadPool(size_t numThreads)
 
 // Destructor: Stop all threads in the pool
 ThreadPool::~ThreadPool() {
+	stopAutoscaling();
+	// No more delayed tasks are posted once the timer thread has stopped
+	m_timers.reset();
 	stopAllThreads();
 }
 
+// Start or stop workers until there are 'numThreads'
+void ThreadPool::resize(size_t numThreads) {
+	numThreads = std::max<size_t>(numThreads, 1);
+	std::scoped_lock lock{m_resizeMutex};
+	if (numThreads > m_threads.size()) {
+		try
+		{
+			m_threads.reserve(numThreads);
+			while (m_threads.size() < numThreads)
+				startWorker();
+		}
+		catch (const std::exception&)
+		{
+			m_numThreads.store(m_threads.size(), std::memory_order_relaxed);
+			throw;
+		}
+	}
+	else if (numThreads < m_threads.size()) {
+		for (size_t i = numThreads; i < m_threads.size(); ++i)
+			m_threads[i].request_stop();
+		// Wake parked workers so that the retiring ones can see the stop request
+		m_idleEvent.notifyAll();
+		// Joins the retiring workers
+		m_threads.resize(numThreads);
+	}
+	m_numThreads.store(numThreads, std::memory_order_relaxed);
+}
+
+// Start the worker for slot m_threads.size()
+void ThreadPool::startWorker() {
+	size_t index = m_threads.size();
+	// A slot that ran a worker before keeps its counters
+	if (index == m_counters.size())
+		m_counters.push_back(std::make_unique<WorkerCounters>());
+	m_threads.emplace_back(std::bind_front(&ThreadPool::work, this, index, m_counters[index].get()));
+}
+
+// Aggregate the per-worker counters
+PoolMetrics ThreadPool::snapshot() const {
+	PoolMetrics metrics;
+	if (m_ring)
+		metrics.injectorDepth.push_back(m_ring->size());
+	else {
+		auto lanes = m_queue.laneSizes();
+		metrics.injectorDepth.assign(lanes.begin(), lanes.end());
+	}
+	std::scoped_lock lock{m_resizeMutex};
+	for (const auto& counters : m_counters) {
+		metrics.workers.emplace_back().addCounters(*counters);
+		counters->queueWait.addTo(metrics.queueWait);
+		counters->runTime.addTo(metrics.runTime);
+	}
+	return metrics;
+}
+
+// Timer wheel of the pool, created on first use
+TimerWheel& ThreadPool::timers() {
+	std::call_once(m_timersFlag, [this]() { m_timers = std::make_unique<TimerWheel>(); });
+	return *m_timers;
+}
+
+// Resize the pool in the background according to the policy
+void ThreadPool::startAutoscaling(ScalingPolicy policy) {
+	auto autoscaler = std::make_unique<Autoscaler<ThreadPool>>(*this, policy);
+	{
+		std::scoped_lock lock{m_resizeMutex};
+		m_autoscaler.swap(autoscaler);
+	}
+	// The previous autoscaler is joined outside the lock because it may be waiting for the lock in resize()
+}
+
+void ThreadPool::stopAutoscaling() {
+	std::unique_ptr<Autoscaler<ThreadPool>> autoscaler;
+	{
+		std::scoped_lock lock{m_resizeMutex};
+		m_autoscaler.swap(autoscaler);
+	}
+}
+
 // Run a pending task if any
 void ThreadPool::runPendingTask() {
-	std::function<void()> task;
-	if (m_queue.tryPop(task))
+	Task task;
+	if (popTask(task))
 		task();
 	else
 		std::this_thread::yield();
 }
 
+// Enqueue a task according to the overflow policy, or run it on the caller if it was not queued
+void ThreadPool::postTask(Task& task, Priority priority) {
+	if (pushTask(task, priority, !isWorkerThread()))
+		m_idleEvent.notifyOne();
+	else
+		task();
+}
+
+// Enqueue a task on the timer thread
+bool ThreadPool::postFromTimer(Task& task) {
+	// With mayWait false, Block and RunInline fail on a full queue instead of stalling the wheel or running user code on it
+	if (!pushTask(task, Priority::Normal, false))
+		return false;
+	m_idleEvent.notifyOne();
+	return true;
+}
+
+// Enqueue a due task, or retry it on the next tick
+void ThreadPool::postDueTask(TimerWheel& wheel, Task& task) {
+	if (!postFromTimer(task))
+		wheel.schedule(TimerWheel::Clock::duration::zero(), TimerWheel::Clock::duration::zero(),
+			[this, &wheel, task = std::move(task)]() mutable { postDueTask(wheel, task); });
+}
+
+// Enqueue a batch of tasks and wake as many idle workers as there are tasks
+void ThreadPool::postBatch(std::vector<Task>& tasks, Priority priority) {
+	size_t pushed = 0;
+	if (m_ring) {
+		// The ring takes no lock to amortize, but the wakeups are still batched
+		while (pushed < tasks.size() && pushTask(tasks[pushed], priority, false))
+			++pushed;
+	}
+	else
+		pushed = m_queue.pushRange(tasks, priority);
+	m_idleEvent.notify(pushed);
+	// The queue is full. The workers have been woken for the queued tasks, so waiting for room cannot deadlock
+	for (size_t i = pushed; i < tasks.size(); ++i)
+		postTask(tasks[i], priority);
+}
+
+// Push a task to the queue, applying the overflow policy
+bool ThreadPool::pushTask(Task& task, Priority priority, bool mayWait) {
+	if (!m_ring)
+		return m_queue.push(task, priority, mayWait);
+	auto enqueued = m_taskTiming.load(std::memory_order_relaxed) ? PriorityLanes::Clock::now() : PriorityLanes::Clock::time_point{};
+	RingEntry entry{ std::move(task), enqueued };
+	if (m_ring->tryPush(entry))
+		return true;
+	switch (m_overflow) {
+	case OverflowPolicy::Block:
+		if (!mayWait)
+			break;
+		// Sleeps on the ring's EventCount until a worker pops a task
+		m_ring->push(std::move(entry));
+		return true;
+	case OverflowPolicy::DropOldest:
+		do {
+			RingEntry dropped;
+			m_ring->tryPop(dropped);
+		} while (!m_ring->tryPush(entry));
+		return true;
+	default:
+		break;
+	}
+	task = std::move(entry.task);
+	return false;
+}
+
+// Pop a task
+bool ThreadPool::popTask(Task& task, PriorityLanes::Clock::duration* waited) {
+	if (!m_ring)
+		return m_queue.tryPop(task, waited);
+	RingEntry entry;
+	if (!m_ring->tryPop(entry))
+		return false;
+	task = std::move(entry.task);
+	if (waited && entry.enqueued != PriorityLanes::Clock::time_point{})
+		*waited = PriorityLanes::Clock::now() - entry.enqueued;
+	return true;
+}
+
 // Worker function for each thread
-void ThreadPool::work(std::stop_token token) {
+void ThreadPool::work(size_t threadIndex, WorkerCounters* counters, std::stop_token token) {
+	if (!m_cpus.empty())
+		pinCurrentThread(m_cpus[threadIndex % m_cpus.size()].id);
+	t_pool = this;
+	Idler idler{m_idleStrategy, m_idleEvent, counters};
 	while (!token.stop_requested()) {
-		std::function<void()> task;
-		if (m_queue.tryPop(task))
-			task();
+		Task task;
+		// Stays at min() if the queue cannot tell how long the task waited
+		auto waited = PriorityLanes::Clock::duration::min();
+		bool timing = m_taskTiming.load(std::memory_order_relaxed);
+		if (popTask(task, timing ? &waited : nullptr)) {
+			if (timing) {
+				if (waited != PriorityLanes::Clock::duration::min())
+					counters->queueWait.record(waited);
+				auto start = PriorityLanes::Clock::now();
+				task();
+				counters->runTime.record(PriorityLanes::Clock::now() - start);
+			}
+			else
+				task();
+			bumpCounter(counters->tasksExecuted);
+			idler.reset();
+		}
 		else
-			std::this_thread::yield();
+			idler.idle([this]() { return hasTask(); }, token);
 	}
 }
 
@@ -47,4 +232,6 @@ void ThreadPool::work(std::stop_token token) {
 void ThreadPool::stopAllThreads() {
 	for (auto& thread : m_threads)
 		thread.request_stop();
+	// Wake parked workers so that they can see the stop request
+	m_idleEvent.notifyAll();
 }
\ No newline at end of file
@@ -4,52 +4,342 @@
 #include <functional>
 #include <type_traits>
 #include <memory>
-#include "TSQueue.hpp"
+#include <utility>
+#include <vector>
+#include <iterator>
+#include <atomic>
+#include <mutex>
+#include <exception>
+#include <chrono>
+#include <optional>
+#include "PriorityLanes.hpp"
+#include "IdleStrategy.hpp"
+#include "Task.hpp"
+#include "Schedule.hpp"
+#include "Autoscaler.hpp"
+#include "Topology.hpp"
+#include "TimerWheel.hpp"
+#include "Cancellation.hpp"
+#include "Metrics.hpp"
+#include "MPMCQueue.hpp"
+
+// Queue that holds the tasks of a ThreadPool
+enum class QueueBackend
+{
+	PriorityLanes, // Lanes behind one mutex, with priorities, deadlines and aging
+	// Lock-free MPMCQueue. Submitters and workers never take a lock unless they have to wait
+	// Tasks run in FIFO order: priorities and deadlines are ignored. QueueBound::capacity sizes the ring (0 means 4096)
+	Ring
+};
 
 // Thread pool with a centralized queue
 // Potentially high contention on the queue
 // Poor cache utilization - tasks frequently move between processors
+// Tasks are queued in priority lanes. Workers drain higher lanes first, and AgingPolicy keeps lower lanes from starving
+// The queue may be bounded. QueueBound::overflow decides what a submission to a full queue does
 class ThreadPool
 {
 private:
-	size_t m_numThreads; // Number of threads in the thread pool
-	TSQueue<std::function<void()>> m_queue; // Thread-safe queue to hold tasks
+	std::atomic<size_t> m_numThreads; // Number of threads in the thread pool
+	// Task in the ring with the time it was submitted. The time is set only while task timing is enabled
+	struct RingEntry {
+		Task task;
+		PriorityLanes::Clock::time_point enqueued;
+	};
+	PriorityLanes m_queue; // Thread-safe queue to hold tasks
+	std::unique_ptr<MPMCQueue<RingEntry>> m_ring; // Replaces m_queue if the pool uses QueueBackend::Ring
+	OverflowPolicy m_overflow;
+	IdleStrategy m_idleStrategy; // What workers do when the queue is empty
+	EventCount m_idleEvent; // Idle workers park on this until a task is submitted
+	std::vector<Cpu> m_cpus; // CPUs the workers are pinned to in order. Empty if Placement::pinWorkers is not set
+	std::vector<std::unique_ptr<WorkerCounters>> m_counters; // One per worker slot. Kept when a worker retires so that its counts stay in snapshots
+	std::atomic<bool> m_taskTiming{ false };
 	std::vector<std::jthread> m_threads; // Vector to store thread objects
+	mutable std::mutex m_resizeMutex; // Serializes resize(), startAutoscaling() and snapshot()
+	std::unique_ptr<Autoscaler<ThreadPool>> m_autoscaler; // Set while autoscaling
+	std::once_flag m_timersFlag;
+	std::unique_ptr<TimerWheel> m_timers; // Created by the first delayed task
+	static inline thread_local const ThreadPool* t_pool{ nullptr }; // Pool of the calling worker thread, if any
 public:
 	// Delete copy constructor and copy assignment operator
 	ThreadPool(const ThreadPool&) = delete;
 	ThreadPool& operator=(const ThreadPool&) = delete;
 	// Constructor: Initialize the thread pool with a specified number of threads
 	// Leave 2 cores unused for other applications or the OS
-	ThreadPool(size_t numThreads = std::max(std::thread::hardware_concurrency() - 2, 1u));
+	ThreadPool(size_t numThreads = std::max(std::thread::hardware_concurrency(), 3u) - 2, IdleStrategy idleStrategy = {}, AgingPolicy agingPolicy = {},
+		Placement placement = {}, QueueBound queueBound = {}, QueueBackend backend = QueueBackend::PriorityLanes);
 	// Destructor: Stop all threads in the pool
 	~ThreadPool();
 	// Run a pending task if any
 	void runPendingTask();
 	// Submit a callable task to the thread pool and returns a future for the result
+	// If the queue is full, OverflowPolicy::Block waits for room, RunInline runs the task on the caller before returning,
+	// and DropOldest drops a queued task (its future gets std::future_errc::broken_promise)
+	// A worker of this pool never waits for room: it runs the task inline instead, since waiting could deadlock the pool
+	template <class Func>
+	std::future<typename std::invoke_result<Func>::type> submit(Func func, Priority priority = Priority::Normal);
+	// Submit a callable task that is cancelled by a stop request on 'token'
+	// If stop is requested before a worker dequeues the task, the task is discarded without running and its future gets TaskCancelled
+	// func may take the token as its argument to stop cooperatively once it runs. Share one std::stop_source to cancel a group
+	template <class Func>
+	std::future<CancellableResult<Func>> submit(Func func, std::stop_token token, Priority priority = Priority::Normal);
+	// Submit a callable task that should start by the deadline
+	// It is served ahead of every lane once the deadline is within AgingPolicy::deadlineLead. Earliest deadline first
+	template <class Func>
+	std::future<typename std::invoke_result<Func>::type> submitBefore(Func func, PriorityLanes::Clock::time_point deadline);
+	// Submit a callable task without a future (fire-and-forget)
+	// No heap allocation is needed for the task if the callable fits in a Task. The queue reuses its slots once it has grown to its peak length,
+	// so in steady state posting a small callable does not allocate
+	// The callable must not throw
+	template <class Func>
+	void post(Func func, Priority priority = Priority::Normal);
+	template <class Func>
+	void postBefore(Func func, PriorityLanes::Clock::time_point deadline);
+	// Submit a callable task only if the queue has room, whatever the overflow policy
+	// Returns std::nullopt and destroys the callable if the queue is full
 	template <class Func>
-	std::future<typename std::invoke_result<Func>::type> submit(Func func);
+	std::optional<std::future<typename std::invoke_result<Func>::type>> trySubmit(Func func, Priority priority = Priority::Normal);
+	// Returns false and destroys the callable if the queue is full
+	template <class Func>
+	bool tryPost(Func func, Priority priority = Priority::Normal);
+	// Submit every callable in [first, last) and return a future for each result
+	// The whole batch is enqueued under one lock and wakes at most one idle worker per task
+	// If the queue cannot take the whole batch, the rest is submitted one task at a time like submit()
+	template <class InputIt>
+	std::vector<std::future<std::invoke_result_t<std::iter_value_t<InputIt>&>>> submitBulk(InputIt first, InputIt last, Priority priority = Priority::Normal);
+	// Submit func(i) for every i in [0, count) and return one future that is ready when all of them have finished
+	// If any call throws, the future holds the first exception caught
+	// Enqueued like submitBulk(). func is shared by the tasks, so it is not copied per task
+	template <class Func>
+	std::future<void> submitN(size_t count, Func func, Priority priority = Priority::Normal);
+	// Awaitable that resumes the awaiting coroutine on a worker of this pool
+	ScheduleAwaiter<ThreadPool> schedule() { return ScheduleAwaiter<ThreadPool>(*this); }
+	// Submit a callable task once the delay has passed. Returns the timer, for cancelTimer(), and a future for the result
+	// The future gets std::future_errc::broken_promise if the timer is cancelled
+	// The first delayed task starts the pool's timer thread, which posts tasks to the pool when they are due
+	// The timer thread never waits for room and never runs a task itself: a due task that finds the queue full is retried on the next tick,
+	// whatever the overflow policy, and can no longer be cancelled
+	template <class Func>
+	std::pair<TimerWheel::TimerId, std::future<typename std::invoke_result<Func>::type>> submitAfter(TimerWheel::Clock::duration delay, Func func);
+	// Submit a callable task without a future once the delay has passed
+	template <class Func>
+	TimerWheel::TimerId postAfter(TimerWheel::Clock::duration delay, Func func);
+	// Submit a callable task every period, starting one period from now, until cancelTimer()
+	// The callable is shared by the runs. A run may overlap the next one if it takes longer than the period
+	// A run that finds the queue full is skipped, like a period missed while the timer thread was late
+	template <class Func>
+	TimerWheel::TimerId submitEvery(TimerWheel::Clock::duration period, Func func);
+	// Cancel a delayed or periodic task. O(1). Returns false if it has already been posted to the pool (one-shot) or cancelled
+	bool cancelTimer(TimerWheel::TimerId id) { return timers().cancel(id); }
 	// Check if the given future is ready
 	template <class T>
 	static bool isFutureReady(std::future<T>& future);
+	// Number of worker threads
+	size_t getNumThreads() const { return m_numThreads.load(std::memory_order_relaxed); }
+	// Start or stop workers until there are 'numThreads' (at least 1)
+	// Retiring workers finish their current task first. Queued tasks stay in the shared queue
+	// Must not be called from a worker of this pool
+	void resize(size_t numThreads);
+	// Resize the pool in the background according to the policy. Replaces the previous policy if any
+	void startAutoscaling(ScalingPolicy policy = {});
+	void stopAutoscaling();
+	// Load measures used by the autoscaler
+	size_t queueSize() const { return m_ring ? m_ring->size() : m_queue.size(); }
+	// Not tracked by the ring backend, which always reports 0
+	PriorityLanes::Clock::duration oldestTaskWait() const { return m_ring ? PriorityLanes::Clock::duration::zero() : m_queue.oldestWait(); }
+	size_t numIdleWorkers() const { return m_idleEvent.numWaiters(); }
+	// Aggregate the per-worker counters. The injector depths are the High, Normal and Low lanes followed by the deadline lane
+	// Workers only write their own counters, so collecting metrics adds no shared writes to the task path
+	PoolMetrics snapshot() const;
+	// Record the queue wait and run time histograms. Off by default because it reads the clock twice more per task
+	void setTaskTiming(bool enabled) { m_taskTiming.store(enabled, std::memory_order_relaxed); }
+	// Whether the caller is a worker thread of this pool
+	bool isWorkerThread() const { return t_pool == this; }
 private:
+	// Enqueue a task according to the overflow policy, or run it on the caller if it was not queued
+	void postTask(Task& task, Priority priority);
+	// Push a task to the queue, applying the overflow policy. Returns false and leaves the task untouched if it was not queued
+	bool pushTask(Task& task, Priority priority, bool mayWait);
+	// Pop a task. 'waited', if given, receives how long it was queued, or is left untouched if that is unknown
+	bool popTask(Task& task, PriorityLanes::Clock::duration* waited = nullptr);
+	bool hasTask() const { return m_ring ? !m_ring->empty() : !m_queue.empty(); }
+	// Enqueue a task on the timer thread. Never waits and never runs the task. Returns false and leaves the task untouched if the queue is full
+	bool postFromTimer(Task& task);
+	// Enqueue a due task, or retry it on the next tick of 'wheel' if the queue is full
+	void postDueTask(TimerWheel& wheel, Task& task);
+	// Enqueue a batch of tasks and wake as many idle workers as there are tasks
+	void postBatch(std::vector<Task>& tasks, Priority priority);
 	// Worker function for each thread
-	void work(std::stop_token token);
+	void work(size_t threadIndex, WorkerCounters* counters, std::stop_token token);
+	// Start the worker for slot m_threads.size()
+	void startWorker();
+	// Timer wheel of the pool, created on first use
+	TimerWheel& timers();
 	// Stop all threads in the pool
 	void stopAllThreads();
 };
 
 // Submits a callable task to the thread pool and returns a future for the result
 template <class Func>
-std::future<typename std::invoke_result<Func>::type> ThreadPool::submit(Func func) {
+std::future<typename std::invoke_result<Func>::type> ThreadPool::submit(Func func, Priority priority) {
+	using ResultType = typename std::invoke_result<Func>::type;
+	std::packaged_task<ResultType()> task{std::move(func)};
+	auto future{ task.get_future() };
+	// std::packaged_task is move-only, so it is stored in the Task directly
+	post(std::move(task), priority);
+	return future;
+}
+
+// Submits a callable task that is cancelled by a stop request on the token
+template <class Func>
+std::future<CancellableResult<Func>> ThreadPool::submit(Func func, std::stop_token token, Priority priority) {
+	CancellableTask<Func> task{std::move(func), std::move(token)};
+	auto future{ task.getFuture() };
+	post(std::move(task), priority);
+	return future;
+}
+
+// Submits a callable task that should start by the deadline
+template <class Func>
+std::future<typename std::invoke_result<Func>::type> ThreadPool::submitBefore(Func func, PriorityLanes::Clock::time_point deadline) {
+	using ResultType = typename std::invoke_result<Func>::type;
+	std::packaged_task<ResultType()> task{std::move(func)};
+	auto future{ task.get_future() };
+	postBefore(std::move(task), deadline);
+	return future;
+}
+
+// Submit a callable task without a future
+template <class Func>
+void ThreadPool::post(Func func, Priority priority) {
+	Task task{std::move(func)};
+	postTask(task, priority);
+}
+
+// Submit a callable task without a future that should start by the deadline
+template <class Func>
+void ThreadPool::postBefore(Func func, PriorityLanes::Clock::time_point deadline) {
+	Task task{std::move(func)};
+	bool queued = m_ring ? pushTask(task, Priority::Normal, !isWorkerThread()) : m_queue.pushDeadline(task, deadline, !isWorkerThread());
+	if (queued)
+		m_idleEvent.notifyOne();
+	else
+		task();
+}
+
+// Submit a callable task only if the queue has room
+template <class Func>
+std::optional<std::future<typename std::invoke_result<Func>::type>> ThreadPool::trySubmit(Func func, Priority priority) {
 	using ResultType = typename std::invoke_result<Func>::type;
 	std::packaged_task<ResultType()> task{std::move(func)};
 	auto future{ task.get_future() };
-	// Wrap the packaged task with a lambda function to store it in the queue
-	m_queue.push([t = std::make_shared<decltype(task)>(std::move(task))]() { (*t)(); });
+	if (!tryPost(std::move(task), priority))
+		return std::nullopt;
 	return future;
 }
 
+template <class Func>
+bool ThreadPool::tryPost(Func func, Priority priority) {
+	Task task{std::move(func)};
+	if (m_ring) {
+		RingEntry entry{ std::move(task), {} };
+		if (!m_ring->tryPush(entry))
+			return false;
+	}
+	else if (!m_queue.tryPush(task, priority))
+		return false;
+	m_idleEvent.notifyOne();
+	return true;
+}
+
+// Submit every callable in [first, last)
+template <class InputIt>
+std::vector<std::future<std::invoke_result_t<std::iter_value_t<InputIt>&>>> ThreadPool::submitBulk(InputIt first, InputIt last, Priority priority) {
+	using ResultType = std::invoke_result_t<std::iter_value_t<InputIt>&>;
+	std::vector<std::future<ResultType>> futures;
+	std::vector<Task> tasks;
+	for (; first != last; ++first) {
+		std::packaged_task<ResultType()> task{*first};
+		futures.emplace_back(task.get_future());
+		tasks.emplace_back(std::move(task));
+	}
+	postBatch(tasks, priority);
+	return futures;
+}
+
+// Submit func(i) for every i in [0, count)
+template <class Func>
+std::future<void> ThreadPool::submitN(size_t count, Func func, Priority priority) {
+	// State shared by the tasks of one call. The last task to finish completes the promise,
+	// so the future is never ready while another task may still be running func
+	struct BulkState {
+		Func func;
+		std::atomic<size_t> remaining;
+		std::atomic<bool> failed{ false };
+		std::exception_ptr exception; // First exception caught. Written once, read by the last task after 'remaining' reaches 0
+		std::promise<void> promise;
+		BulkState(Func&& func_, size_t count) : func(std::move(func_)), remaining(count) {}
+	};
+	auto state = std::make_shared<BulkState>(std::move(func), count);
+	auto future = state->promise.get_future();
+	if (count == 0) {
+		state->promise.set_value();
+		return future;
+	}
+	std::vector<Task> tasks;
+	tasks.reserve(count);
+	for (size_t i = 0; i < count; ++i) {
+		tasks.emplace_back([state, i]() {
+			try {
+				state->func(i);
+			}
+			catch (...) {
+				if (!state->failed.exchange(true, std::memory_order_acq_rel))
+					state->exception = std::current_exception();
+			}
+			if (state->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				if (state->exception)
+					state->promise.set_exception(state->exception);
+				else
+					state->promise.set_value();
+			}
+		});
+	}
+	postBatch(tasks, priority);
+	return future;
+}
+
+// Submit a callable task once the delay has passed
+template <class Func>
+std::pair<TimerWheel::TimerId, std::future<typename std::invoke_result<Func>::type>> ThreadPool::submitAfter(TimerWheel::Clock::duration delay, Func func) {
+	using ResultType = typename std::invoke_result<Func>::type;
+	std::packaged_task<ResultType()> task{std::move(func)};
+	auto future{ task.get_future() };
+	auto timer = postAfter(delay, std::move(task));
+	return { timer, std::move(future) };
+}
+
+// Submit a callable task without a future once the delay has passed
+template <class Func>
+TimerWheel::TimerId ThreadPool::postAfter(TimerWheel::Clock::duration delay, Func func) {
+	// The timer thread only moves the callable into the pool's queue. 'wheel' outlives its callbacks, unlike m_timers while it is reset
+	auto& wheel = timers();
+	return wheel.schedule(delay, TimerWheel::Clock::duration::zero(), [this, &wheel, func = std::move(func)]() mutable {
+		Task task{ std::move(func) };
+		postDueTask(wheel, task);
+	});
+}
+
+// Submit a callable task every period
+template <class Func>
+TimerWheel::TimerId ThreadPool::submitEvery(TimerWheel::Clock::duration period, Func func) {
+	auto shared = std::make_shared<Func>(std::move(func));
+	return timers().schedule(period, period, [this, shared]() {
+		Task task{ [shared]() { (*shared)(); } };
+		postFromTimer(task);
+	});
+}
+
 // Check if the given future is ready
 template <class T>
 bool ThreadPool::isFutureReady(std::future<T>& future) {
@@ -0,0 +1,325 @@
+#pragma once
+#include <thread>
+#include <stop_token>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <array>
+#include <vector>
+#include <bit>
+#include <limits>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include "Task.hpp"
+
+// Hierarchical timing wheel serviced by one timer thread
+// Time is split into ticks of 'resolution'. 4 levels of 64 slots cover 2^24 ticks (about 4.6 hours at 1ms).
+// A timer is linked into the slot of the coarsest level that still tells it apart from the current tick
+// and moves down a level each time its slot comes around, so scheduling and cancelling are O(1)
+// Timers further away than the wheel covers wait in the last slot of the top level and are placed again when it comes around
+// Callbacks run on the timer thread and must be short and must not throw, e.g. post a task to a pool
+/* Usage:
+TimerWheel timers;
+auto timer = timers.schedule(100ms, 0ms, []() { std::cout << "once\n"; });
+timers.schedule(10ms, 10ms, []() { std::cout << "every 10ms\n"; });
+timers.cancel(timer);
+*/
+class TimerWheel
+{
+public:
+	using Clock = std::chrono::steady_clock;
+private:
+	static constexpr unsigned slotBits{6};
+	static constexpr uint64_t numSlots{ uint64_t{1} << slotBits };
+	static constexpr unsigned numLevels{4};
+	static constexpr uint64_t maxDelta{ (uint64_t{1} << (slotBits * numLevels)) - 1 }; // Farthest tick the wheel tells apart
+	enum class State { Free, Pending, Firing, Cancelled };
+	struct Node {
+		Task callback;
+		uint64_t expiry{ 0 }; // Tick
+		uint64_t period{ 0 }; // Ticks. 0 for one-shot timers
+		uint64_t generation{ 0 }; // Incremented whenever the node is freed so that stale TimerIds do not match
+		State state{ State::Free };
+		Node* prev{ nullptr };
+		Node* next{ nullptr };
+		unsigned level{ 0 };
+		unsigned slot{ 0 };
+	};
+public:
+	// Handle of a scheduled timer. Stays safe to cancel after the timer has fired
+	class TimerId
+	{
+		friend class TimerWheel;
+		Node* m_node{ nullptr };
+		uint64_t m_generation{ 0 };
+		TimerId(Node* node, uint64_t generation) : m_node(node), m_generation(generation) {}
+	public:
+		TimerId() = default;
+	};
+private:
+	mutable std::mutex m_mutex;
+	std::condition_variable_any m_cond;
+	Clock::duration m_resolution;
+	Clock::time_point m_start; // Time of tick 0
+	uint64_t m_now{ 0 }; // Last tick processed
+	uint64_t m_wakeTick{ std::numeric_limits<uint64_t>::max() }; // Tick the timer thread sleeps until
+	std::array<std::array<Node*, numSlots>, numLevels> m_slots{}; // Heads of doubly linked lists
+	std::array<uint64_t, numLevels> m_occupied{}; // Bit i is set if slot i of the level is not empty
+	size_t m_size{ 0 }; // Pending timers
+	Node* m_free{ nullptr }; // Recycled nodes, linked through 'next'
+	std::vector<std::unique_ptr<Node[]>> m_blocks; // Node storage. Nodes are never deleted before the wheel
+	std::jthread m_thread; // Declared last so that it starts after the other members are initialized
+public:
+	explicit TimerWheel(Clock::duration resolution = std::chrono::milliseconds(1));
+	TimerWheel(const TimerWheel&) = delete;
+	TimerWheel& operator=(const TimerWheel&) = delete;
+	// Stops the timer thread. Pending callbacks are destroyed without being called
+	~TimerWheel();
+	// Call 'callback' on the timer thread once 'delay' has passed (never earlier), then every 'period' if it is not zero
+	// Periodic timers keep a fixed rate. Periods missed while the timer thread was late are skipped
+	TimerId schedule(Clock::duration delay, Clock::duration period, Task callback);
+	// Stop a timer. Returns false if it has already fired (one-shot), was cancelled, or is running right now (one-shot)
+	bool cancel(TimerId id);
+	// Number of pending timers
+	size_t size() const;
+private:
+	void run(std::stop_token token);
+	// First tick that starts at or after 'time'
+	uint64_t toTick(Clock::time_point time) const;
+	// Tick that 'time' falls into
+	uint64_t currentTick(Clock::time_point time) const;
+	Node* allocateNode();
+	void freeNode(Node* node);
+	// Link a node into its slot relative to m_now
+	void link(Node* node);
+	void unlink(Node* node);
+	// Next tick at which a slot has to be fired or cascaded. max() if the wheel is empty
+	uint64_t nextEventTick() const;
+	// Cascade the slots that come around at m_now and move the timers that expire now to 'due'
+	void processTick(std::vector<Node*>& due);
+};
+
+inline TimerWheel::TimerWheel(Clock::duration resolution)
+	: m_resolution(std::max(resolution, Clock::duration{ 1 })), m_start(Clock::now()), m_thread(std::bind_front(&TimerWheel::run, this))
+{
+}
+
+inline TimerWheel::~TimerWheel() {
+	m_thread.request_stop();
+	m_thread.join();
+	// Destroy the pending callbacks while the node storage is alive
+	for (auto& level : m_slots) {
+		for (Node* head : level) {
+			for (Node* node = head; node; node = node->next)
+				node->callback.reset();
+		}
+	}
+}
+
+inline TimerWheel::TimerId TimerWheel::schedule(Clock::duration delay, Clock::duration period, Task callback) {
+	auto now = Clock::now();
+	std::scoped_lock lock{m_mutex};
+	// The timer thread leaves m_now behind while the wheel is empty. Catch up so that the new timer is placed from the current tick
+	if (m_size == 0)
+		m_now = std::max(m_now, currentTick(now));
+	Node* node = allocateNode();
+	node->callback = std::move(callback);
+	// Round the period up so that a periodic timer never fires more often than asked
+	node->period = period > Clock::duration::zero() ? static_cast<uint64_t>((period + m_resolution - Clock::duration{ 1 }) / m_resolution) : 0;
+	node->expiry = std::max(toTick(now + std::max(delay, Clock::duration::zero())), m_now + 1);
+	node->state = State::Pending;
+	link(node);
+	++m_size;
+	// Wake the timer thread if the new timer is due before the thread planned to wake up
+	if (node->expiry < m_wakeTick)
+		m_cond.notify_one();
+	return TimerId(node, node->generation);
+}
+
+inline bool TimerWheel::cancel(TimerId id) {
+	if (!id.m_node)
+		return false;
+	std::scoped_lock lock{m_mutex};
+	Node* node = id.m_node;
+	if (node->generation != id.m_generation)
+		return false;
+	if (node->state == State::Pending) {
+		unlink(node);
+		--m_size;
+		freeNode(node);
+		return true;
+	}
+	// A periodic timer that is firing right now is freed by the timer thread instead of being linked again
+	if (node->state == State::Firing && node->period) {
+		node->state = State::Cancelled;
+		return true;
+	}
+	return false;
+}
+
+inline size_t TimerWheel::size() const {
+	std::scoped_lock lock{m_mutex};
+	return m_size;
+}
+
+inline void TimerWheel::run(std::stop_token token) {
+	std::vector<Node*> due;
+	std::unique_lock lock{m_mutex};
+	while (!token.stop_requested()) {
+		// Process every tick that has a slot to fire or cascade up to the current tick
+		uint64_t current = currentTick(Clock::now());
+		for (uint64_t tick = nextEventTick(); tick <= current; tick = nextEventTick()) {
+			m_now = tick;
+			processTick(due);
+		}
+		m_now = std::max(m_now, current);
+		if (!due.empty()) {
+			// Call the callbacks without holding the lock so that they may schedule and cancel timers
+			lock.unlock();
+			for (Node* node : due)
+				node->callback();
+			lock.lock();
+			for (Node* node : due) {
+				if (node->period && node->state == State::Firing) {
+					node->expiry = std::max(node->expiry + node->period, m_now + 1);
+					node->state = State::Pending;
+					link(node);
+				}
+				else {
+					--m_size;
+					freeNode(node);
+				}
+			}
+			due.clear();
+			continue;
+		}
+		m_wakeTick = nextEventTick();
+		if (m_wakeTick == std::numeric_limits<uint64_t>::max())
+			m_cond.wait(lock, token, [this]() { return m_size > 0; });
+		else
+			m_cond.wait_until(lock, token, m_start + m_resolution * static_cast<Clock::rep>(m_wakeTick), [this, wakeTick = m_wakeTick]() {
+				return nextEventTick() < wakeTick;
+			});
+		m_wakeTick = std::numeric_limits<uint64_t>::max();
+	}
+}
+
+inline uint64_t TimerWheel::toTick(Clock::time_point time) const {
+	auto elapsed = time - m_start;
+	if (elapsed <= Clock::duration::zero())
+		return 0;
+	return static_cast<uint64_t>((elapsed + m_resolution - Clock::duration{ 1 }) / m_resolution);
+}
+
+inline uint64_t TimerWheel::currentTick(Clock::time_point time) const {
+	auto elapsed = time - m_start;
+	if (elapsed <= Clock::duration::zero())
+		return 0;
+	return static_cast<uint64_t>(elapsed / m_resolution);
+}
+
+inline TimerWheel::Node* TimerWheel::allocateNode() {
+	if (!m_free) {
+		// Allocate nodes in blocks that grow with the number of timers
+		size_t blockSize = std::max<size_t>(64, m_size);
+		m_blocks.emplace_back(std::make_unique<Node[]>(blockSize));
+		Node* block = m_blocks.back().get();
+		for (size_t i = 0; i < blockSize; ++i) {
+			block[i].next = m_free;
+			m_free = &block[i];
+		}
+	}
+	Node* node = m_free;
+	m_free = node->next;
+	node->next = nullptr;
+	return node;
+}
+
+inline void TimerWheel::freeNode(Node* node) {
+	node->callback.reset();
+	node->state = State::Free;
+	++node->generation;
+	node->prev = nullptr;
+	node->next = m_free;
+	m_free = node;
+}
+
+inline void TimerWheel::link(Node* node) {
+	uint64_t delta = node->expiry - m_now;
+	unsigned level = 0;
+	while (level + 1 < numLevels && delta >= (uint64_t{1} << (slotBits * (level + 1))))
+		++level;
+	// Too far for the wheel: park in the slot that comes around last and place again from there
+	uint64_t expiry = delta > maxDelta ? m_now + maxDelta : node->expiry;
+	unsigned slot = static_cast<unsigned>((expiry >> (slotBits * level)) & (numSlots - 1));
+	node->level = level;
+	node->slot = slot;
+	node->prev = nullptr;
+	node->next = m_slots[level][slot];
+	if (node->next)
+		node->next->prev = node;
+	m_slots[level][slot] = node;
+	m_occupied[level] |= uint64_t{1} << slot;
+}
+
+inline void TimerWheel::unlink(Node* node) {
+	if (node->prev)
+		node->prev->next = node->next;
+	else
+		m_slots[node->level][node->slot] = node->next;
+	if (node->next)
+		node->next->prev = node->prev;
+	if (!m_slots[node->level][node->slot])
+		m_occupied[node->level] &= ~(uint64_t{1} << node->slot);
+	node->prev = node->next = nullptr;
+}
+
+inline uint64_t TimerWheel::nextEventTick() const {
+	uint64_t next = std::numeric_limits<uint64_t>::max();
+	for (unsigned level = 0; level < numLevels; ++level) {
+		if (!m_occupied[level])
+			continue;
+		unsigned shift = slotBits * level;
+		uint64_t index = m_now >> shift;
+		// Slots after the current one in this rotation, then the rest of the next rotation. The current slot comes last
+		uint64_t rotated = std::rotr(m_occupied[level], static_cast<int>((index + 1) & (numSlots - 1)));
+		uint64_t offset = static_cast<uint64_t>(std::countr_zero(rotated)) + 1;
+		next = std::min(next, (index + offset) << shift);
+	}
+	return next;
+}
+
+inline void TimerWheel::processTick(std::vector<Node*>& due) {
+	// Cascade from the coarsest level that comes around at this tick down to level 1
+	unsigned top = 0;
+	while (top + 1 < numLevels && (m_now & ((uint64_t{1} << (slotBits * (top + 1))) - 1)) == 0)
+		++top;
+	for (unsigned level = top; level > 0; --level) {
+		unsigned slot = static_cast<unsigned>((m_now >> (slotBits * level)) & (numSlots - 1));
+		Node* node = m_slots[level][slot];
+		m_slots[level][slot] = nullptr;
+		m_occupied[level] &= ~(uint64_t{1} << slot);
+		while (node) {
+			Node* next = node->next;
+			if (node->expiry <= m_now) {
+				node->state = State::Firing;
+				due.push_back(node);
+			}
+			else
+				link(node);
+			node = next;
+		}
+	}
+	unsigned slot = static_cast<unsigned>(m_now & (numSlots - 1));
+	Node* node = m_slots[0][slot];
+	m_slots[0][slot] = nullptr;
+	m_occupied[0] &= ~(uint64_t{1} << slot);
+	while (node) {
+		Node* next = node->next;
+		node->state = State::Firing;
+		due.push_back(node);
+		node = next;
+	}
+}
@@ -0,0 +1,138 @@
+#include "Topology.hpp"
+#include <algorithm>
+#include <tuple>
+#include <thread>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <fstream>
+#include <string>
+#endif
+
+#ifdef _WIN32
+
+// Index of the lowest set bit of a non-zero mask
+static unsigned lowestBit(ULONG_PTR mask) {
+	unsigned index = 0;
+	while (!((mask >> index) & 1))
+		++index;
+	return index;
+}
+
+CpuTopology CpuTopology::detect() {
+	CpuTopology topology;
+	DWORD length = 0;
+	GetLogicalProcessorInformation(nullptr, &length);
+	std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> info(length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+	if (!GetLogicalProcessorInformation(info.data(), &length))
+		info.clear();
+	DWORD_PTR processMask, systemMask;
+	if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+		processMask = 0;
+	for (unsigned id = 0; id < sizeof(DWORD_PTR) * 8; ++id) {
+		if (!((processMask >> id) & 1))
+			continue;
+		Cpu cpu{ id, id, 0 };
+		BYTE cacheLevel = 0;
+		for (const auto& entry : info) {
+			if (!((entry.ProcessorMask >> id) & 1))
+				continue;
+			if (entry.Relationship == RelationProcessorCore)
+				cpu.core = lowestBit(entry.ProcessorMask);
+			else if (entry.Relationship == RelationCache && entry.Cache.Level > cacheLevel) {
+				cacheLevel = entry.Cache.Level;
+				cpu.cacheDomain = lowestBit(entry.ProcessorMask);
+			}
+		}
+		topology.m_cpus.push_back(cpu);
+	}
+	return topology;
+}
+
+bool pinCurrentThread(unsigned cpu) {
+	if (cpu >= sizeof(DWORD_PTR) * 8)
+		return false;
+	return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR{ 1 } << cpu) != 0;
+}
+
+#else
+
+// Read the first number of a sysfs file. For a CPU list such as "0-3,8-11" that is the lowest CPU
+static bool readFirstNumber(const std::string& path, unsigned& number) {
+	std::ifstream file(path);
+	return static_cast<bool>(file >> number);
+}
+
+// Lowest CPU sharing the highest level cache of the given CPU. 0 if the caches are unknown
+static unsigned lastLevelCacheDomain(unsigned cpu) {
+	unsigned domain = 0;
+	unsigned cacheLevel = 0;
+	for (unsigned index = 0;; ++index) {
+		std::string cache = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cache/index" + std::to_string(index) + "/";
+		unsigned level, first;
+		if (!readFirstNumber(cache + "level", level))
+			break;
+		if (level > cacheLevel && readFirstNumber(cache + "shared_cpu_list", first)) {
+			cacheLevel = level;
+			domain = first;
+		}
+	}
+	return domain;
+}
+
+CpuTopology CpuTopology::detect() {
+	CpuTopology topology;
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+		// Unknown topology: every CPU is a core of its own in one cache domain
+		for (unsigned id = 0; id < std::thread::hardware_concurrency(); ++id)
+			topology.m_cpus.push_back(Cpu{ id, id, 0 });
+		return topology;
+	}
+	for (unsigned id = 0; id < CPU_SETSIZE; ++id) {
+		if (!CPU_ISSET(id, &set))
+			continue;
+		Cpu cpu{ id, id, 0 };
+		readFirstNumber("/sys/devices/system/cpu/cpu" + std::to_string(id) + "/topology/thread_siblings_list", cpu.core);
+		cpu.cacheDomain = lastLevelCacheDomain(id);
+		topology.m_cpus.push_back(cpu);
+	}
+	return topology;
+}
+
+bool pinCurrentThread(unsigned cpu) {
+	if (cpu >= CPU_SETSIZE)
+		return false;
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+#endif
+
+// CPUs in the order workers are placed on them
+std::vector<Cpu> CpuTopology::placementOrder() const {
+	// The first available thread of each core, then the other SMT threads
+	std::vector<Cpu> first, others;
+	std::vector<unsigned> seenCores;
+	for (const Cpu& cpu : m_cpus) {
+		if (std::find(seenCores.begin(), seenCores.end(), cpu.core) == seenCores.end()) {
+			seenCores.push_back(cpu.core);
+			first.push_back(cpu);
+		}
+		else
+			others.push_back(cpu);
+	}
+	auto byCacheDomain = [](const Cpu& a, const Cpu& b) { return std::tie(a.cacheDomain, a.id) < std::tie(b.cacheDomain, b.id); };
+	std::sort(first.begin(), first.end(), byCacheDomain);
+	std::sort(others.begin(), others.end(), byCacheDomain);
+	first.insert(first.end(), others.begin(), others.end());
+	return first;
+}
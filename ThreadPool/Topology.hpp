@@ -0,0 +1,37 @@
+#pragma once
+#include <vector>
+
+// How pool workers are placed on CPUs
+struct Placement
+{
+	// Pin worker i to CpuTopology::placementOrder()[i % number of CPUs] so that the OS does not migrate it
+	bool pinWorkers{ false };
+	// WSThreadPool: probe the victims that share the thief's last level cache before the others. Needs pinWorkers
+	bool localStealFirst{ true };
+};
+
+// Logical CPU the process may run on
+struct Cpu
+{
+	unsigned id; // OS index of the logical CPU
+	unsigned core; // Lowest id among its SMT siblings
+	unsigned cacheDomain; // Lowest id among the CPUs that share its last level cache
+};
+
+// CPUs available to the process
+// Read from /sys/devices/system/cpu on Linux and from GetLogicalProcessorInformation on Windows (first processor group only)
+class CpuTopology
+{
+private:
+	std::vector<Cpu> m_cpus; // Sorted by id
+public:
+	static CpuTopology detect();
+	const std::vector<Cpu>& cpus() const { return m_cpus; }
+	// CPUs in the order workers are placed on them
+	// One SMT thread of every core comes before any second thread of a core, so that workers get a core of their own first
+	// Within that, CPUs are grouped by cache domain, so that neighbouring workers share a cache
+	std::vector<Cpu> placementOrder() const;
+};
+
+// Pin the calling thread to one logical CPU. Returns false if the OS refused
+bool pinCurrentThread(unsigned cpu);
@@ -1,7 +1,22 @@
 #include "ThreadPool.hpp"
+#include "AllocationCounter.hpp"
 #include <vector>
 #include <iostream>
 #include <string>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <stdexcept>
+#include <bit>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace std::chrono_literals;
 
 void sayHi() {
 	std::cout << "Hi\n";
@@ -22,6 +37,466 @@ int five() {
 	return 5;
 }
 
+// CPU time consumed by all threads of this process so far
+std::chrono::microseconds processCpuTime() {
+#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+	GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+	auto toMicroseconds = [](FILETIME time) {
+		return ((static_cast<long long>(time.dwHighDateTime) << 32) | time.dwLowDateTime) / 10;
+	};
+	return std::chrono::microseconds(toMicroseconds(kernel) + toMicroseconds(user));
+#else
+	rusage usage{};
+	getrusage(RUSAGE_SELF, &usage);
+	auto toMicroseconds = [](timeval time) {
+		return static_cast<long long>(time.tv_sec) * 1000000 + time.tv_usec;
+	};
+	return std::chrono::microseconds(toMicroseconds(usage.ru_utime) + toMicroseconds(usage.ru_stime));
+#endif
+}
+
+// Measure the CPU usage of an idle pool and the latency of waking it up with a task
+void benchmarkIdle(const std::string& name, IdleStrategy idleStrategy) {
+	constexpr size_t numThreads{4};
+	ThreadPool pool(numThreads, idleStrategy);
+	std::this_thread::sleep_for(100ms); // Let the workers run out of work
+
+	auto cpu1 = processCpuTime();
+	auto wall1 = std::chrono::steady_clock::now();
+	std::this_thread::sleep_for(1s);
+	auto cpu2 = processCpuTime();
+	auto wall2 = std::chrono::steady_clock::now();
+	double cpuUsage = 100.0 * (cpu2 - cpu1).count() / std::chrono::duration_cast<std::chrono::microseconds>(wall2 - wall1).count();
+
+	// Time from submit to the start of the task, with the pool idle before every submit
+	std::vector<long long> latencies;
+	for (size_t i = 0; i < 200; ++i) {
+		std::this_thread::sleep_for(2ms);
+		auto submitted = std::chrono::steady_clock::now();
+		auto started = pool.submit([]() { return std::chrono::steady_clock::now(); }).get();
+		latencies.push_back(std::chrono::duration_cast<std::chrono::microseconds>(started - submitted).count());
+	}
+	std::sort(latencies.begin(), latencies.end());
+	std::cout << name << ": idle CPU " << cpuUsage << "% of one core"
+		<< ", wakeup latency p50 " << latencies[latencies.size() / 2] << "us"
+		<< ", p99 " << latencies[latencies.size() * 99 / 100] << "us\n";
+}
+
+// Measure heap allocations and throughput of post() and submit() with a small lambda
+void benchmarkSubmit() {
+	constexpr size_t numTasks{100000};
+	ThreadPool pool(4);
+	std::atomic<size_t> counter{0};
+	auto smallTask = [&counter]() { counter.fetch_add(1, std::memory_order_relaxed); };
+
+	// Storing a small lambda in a Task does not allocate
+	auto before = allocations.load();
+	for (size_t i = 0; i < numTasks; ++i) {
+		Task task{smallTask};
+		task();
+	}
+	std::cout << "Task: " << static_cast<double>(allocations.load() - before) / numTasks << " allocations per task\n";
+
+	// The first run grows the queue's ring buffers to their peak length. Later runs reuse them
+	counter = 0;
+	for (size_t i = 0; i < numTasks; ++i)
+		pool.post(smallTask);
+	while (counter.load() < numTasks)
+		std::this_thread::yield();
+	counter = 0;
+	before = allocations.load();
+	auto t1 = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < numTasks; ++i)
+		pool.post(smallTask);
+	while (counter.load() < numTasks)
+		std::this_thread::yield();
+	auto t2 = std::chrono::steady_clock::now();
+	std::cout << "post: " << static_cast<double>(allocations.load() - before) / numTasks << " allocations per task, "
+		<< std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count() << "ms\n";
+
+	std::vector<std::future<void>> futures;
+	futures.reserve(numTasks);
+	counter = 0;
+	before = allocations.load();
+	t1 = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < numTasks; ++i)
+		futures.emplace_back(pool.submit(smallTask));
+	for (auto& future : futures)
+		future.get();
+	t2 = std::chrono::steady_clock::now();
+	std::cout << "submit: " << static_cast<double>(allocations.load() - before) / numTasks << " allocations per task, "
+		<< std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count() << "ms\n";
+}
+
+// Busy the worker for the given time, like a CPU bound job
+void work(std::chrono::microseconds duration) {
+	auto end = std::chrono::steady_clock::now() + duration;
+	while (std::chrono::steady_clock::now() < end);
+}
+
+// Compare submitting small tasks one by one with submitting them as one batch
+void benchmarkBulk() {
+	constexpr size_t numTasks{100000};
+	ThreadPool pool(4);
+	std::vector<int> squares(numTasks);
+
+	auto t1 = std::chrono::steady_clock::now();
+	std::vector<std::future<void>> futures;
+	futures.reserve(numTasks);
+	for (size_t i = 0; i < numTasks; ++i)
+		futures.emplace_back(pool.submit([&squares, i]() { squares[i] = static_cast<int>(i * i); }));
+	for (auto& future : futures)
+		future.get();
+	auto t2 = std::chrono::steady_clock::now();
+	pool.submitN(numTasks, [&squares](size_t i) { squares[i] = static_cast<int>(i * i); }).get();
+	auto t3 = std::chrono::steady_clock::now();
+	std::cout << "submit one by one: " << std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count() << "ms, "
+		<< "submitN: " << std::chrono::duration_cast<std::chrono::milliseconds>(t3 - t2).count() << "ms\n";
+
+	// A batch of callables with a future each
+	std::vector<std::function<int()>> jobs;
+	for (int i = 0; i < 10; ++i)
+		jobs.emplace_back([i]() { return i * i; });
+	auto results = pool.submitBulk(jobs.begin(), jobs.end());
+	for (int i = 0; i < 10; ++i) {
+		[[maybe_unused]] int square = results[i].get();
+		assert(square == i * i);
+	}
+
+	// The aggregate future carries the first exception, and is ready only once every task has finished
+	std::atomic<int> finished{0};
+	auto failing = pool.submitN(10, [&finished](size_t i) {
+		work(std::chrono::microseconds(100 * i)); // Tasks after the failing one are still running when it throws
+		++finished;
+		if (i == 3) throw std::runtime_error("task 3 failed");
+	});
+	try {
+		failing.get();
+		assert(false);
+	}
+	catch (const std::runtime_error& e) {
+		std::cout << "submitN exception: " << e.what() << "\n";
+	}
+	assert(finished == 10);
+}
+
+// Start latency of interactive, regular, and background tasks under a mixed load
+// A backlog of background jobs is queued first, then interactive and regular tasks arrive at a steady rate
+// With lanes, the classes are submitted as High, Normal, and Low. Without them, all of them go to the Normal lane (FIFO)
+void benchmarkPriority(bool useLanes) {
+	constexpr size_t numBackground{1000};
+	constexpr size_t numRequests{200};
+	ThreadPool pool(4);
+	std::vector<long long> background(numBackground), interactive(numRequests), regular(numRequests);
+	std::atomic<size_t> remaining{numBackground + 2 * numRequests};
+	// The task records how long it waited in the queue
+	auto post = [&pool, &remaining](std::vector<long long>& latencies, size_t i, std::chrono::microseconds duration, Priority priority) {
+		pool.post([&latencies, &remaining, i, duration, submitted = std::chrono::steady_clock::now()]() {
+			latencies[i] = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - submitted).count();
+			work(duration);
+			remaining.fetch_sub(1);
+		}, priority);
+	};
+
+	for (size_t i = 0; i < numBackground; ++i)
+		post(background, i, 1ms, useLanes ? Priority::Low : Priority::Normal);
+	for (size_t i = 0; i < numRequests; ++i) {
+		post(interactive, i, 50us, useLanes ? Priority::High : Priority::Normal);
+		post(regular, i, 200us, Priority::Normal);
+		std::this_thread::sleep_for(2ms);
+	}
+	while (remaining.load() > 0)
+		std::this_thread::sleep_for(1ms);
+
+	auto report = [](const char* lane, std::vector<long long>& latencies) {
+		std::sort(latencies.begin(), latencies.end());
+		std::cout << " / " << lane << " p50 " << latencies[latencies.size() / 2] / 1000.0 << "ms, p99 " << latencies[latencies.size() * 99 / 100] / 1000.0 << "ms";
+	};
+	std::cout << (useLanes ? "priority lanes" : "single lane");
+	report("interactive", interactive);
+	report("regular", regular);
+	report("background", background);
+	std::cout << "\n";
+}
+
+// Let the autoscaler follow a burst of work and the idle period after it
+void benchmarkAutoscaling() {
+	ThreadPool pool(1);
+	pool.startAutoscaling(ScalingPolicy{ .minThreads = 1, .maxThreads = 8, .idleTimeout = 200ms });
+	auto t1 = std::chrono::steady_clock::now();
+	auto burst = pool.submitN(2000, [](size_t) { work(500us); });
+	size_t peak = 1;
+	while (!ThreadPool::isFutureReady(burst)) {
+		peak = std::max(peak, pool.getNumThreads());
+		std::this_thread::sleep_for(1ms);
+	}
+	auto t2 = std::chrono::steady_clock::now();
+	while (pool.getNumThreads() > 1 && std::chrono::steady_clock::now() - t2 < 5s)
+		std::this_thread::sleep_for(1ms);
+	auto t3 = std::chrono::steady_clock::now();
+	std::cout << "autoscaling: 1 thread, " << peak << " threads during a " << std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count()
+		<< "ms burst, " << pool.getNumThreads() << " thread " << std::chrono::duration_cast<std::chrono::milliseconds>(t3 - t2).count() << "ms after it\n";
+
+	// Manual resizing
+	pool.stopAutoscaling();
+	pool.resize(6);
+	assert(pool.getNumThreads() == 6);
+	pool.submitN(100, [](size_t) { work(100us); }).get();
+	pool.resize(2);
+	assert(pool.getNumThreads() == 2);
+	pool.submitN(100, [](size_t) { work(100us); }).get();
+}
+
+// Schedule a million timeouts, cancel half of them, and let the rest fire on the pool
+void benchmarkTimers() {
+	constexpr size_t numTimers{1000000};
+	ThreadPool pool(4);
+	std::atomic<size_t> fired{0};
+	std::vector<TimerWheel::TimerId> timers;
+	timers.reserve(numTimers);
+	auto t1 = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < numTimers; ++i)
+		timers.push_back(pool.postAfter(std::chrono::milliseconds(200 + i % 800), [&fired]() { fired.fetch_add(1, std::memory_order_relaxed); }));
+	auto t2 = std::chrono::steady_clock::now();
+	size_t cancelled = 0;
+	for (size_t i = 0; i < numTimers; i += 2)
+		cancelled += pool.cancelTimer(timers[i]);
+	auto t3 = std::chrono::steady_clock::now();
+	while (fired.load() + cancelled < numTimers)
+		std::this_thread::sleep_for(10ms);
+	std::cout << "timers: schedule " << std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count() / numTimers << "ns, cancel "
+		<< std::chrono::duration_cast<std::chrono::nanoseconds>(t3 - t2).count() / (numTimers / 2) << "ns, "
+		<< cancelled << " cancelled, " << fired.load() << " fired\n";
+
+	// Delayed task with a result. It never runs early
+	auto submitted = std::chrono::steady_clock::now();
+	auto [timer, future] = pool.submitAfter(20ms, []() { return std::chrono::steady_clock::now(); });
+	auto lateness = std::chrono::duration_cast<std::chrono::microseconds>(future.get() - submitted - 20ms);
+	assert(lateness.count() >= 0);
+	std::cout << "submitAfter(20ms): ran " << lateness.count() << "us late\n";
+
+	// Periodic task
+	std::atomic<int> runs{0};
+	auto periodic = pool.submitEvery(10ms, [&runs]() { ++runs; });
+	std::this_thread::sleep_for(105ms);
+	[[maybe_unused]] bool stopped = pool.cancelTimer(periodic);
+	assert(stopped);
+	std::this_thread::sleep_for(20ms);
+	std::cout << "submitEvery(10ms): " << runs.load() << " runs in 105ms\n";
+
+	// A cancelled delayed task breaks its promise
+	auto [cancelledTimer, cancelledFuture] = pool.submitAfter(1s, []() { return 0; });
+	[[maybe_unused]] bool cancelledInTime = pool.cancelTimer(cancelledTimer);
+	assert(cancelledInTime);
+	try {
+		cancelledFuture.get();
+		assert(false);
+	}
+	catch ([[maybe_unused]] const std::future_error& e) {
+		assert(e.code() == std::future_errc::broken_promise);
+	}
+}
+
+// A producer submits faster than the workers can run the tasks
+// Reports the peak queue length, and how many tasks ran on the producer or were dropped under each overflow policy
+void benchmarkBackpressure(const char* name, QueueBound bound, QueueBackend backend = QueueBackend::PriorityLanes) {
+	constexpr size_t numTasks{2000};
+	ThreadPool pool(2, {}, {}, {}, bound, backend);
+	std::atomic<size_t> ran{0}, ranInline{0};
+	size_t peak = 0;
+	auto t1 = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < numTasks; ++i) {
+		pool.post([&pool, &ran, &ranInline]() {
+			work(100us);
+			if (!pool.isWorkerThread())
+				ranInline.fetch_add(1);
+			ran.fetch_add(1);
+		});
+		peak = std::max(peak, pool.queueSize());
+	}
+	auto t2 = std::chrono::steady_clock::now();
+	while (pool.queueSize() > 0 || pool.numIdleWorkers() < 2)
+		std::this_thread::sleep_for(1ms);
+	assert(peak <= (bound.capacity ? std::bit_ceil(bound.capacity) : numTasks));
+	std::cout << name << ": peak queue " << peak << ", submitted in " << std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count() << "ms, "
+		<< ranInline.load() << " ran inline, " << numTasks - ran.load() << " dropped\n";
+
+	// trySubmit fails instead of applying the policy
+	if (bound.capacity) {
+		size_t accepted = 0;
+		std::vector<std::future<void>> futures;
+		for (size_t i = 0; i < 2 * bound.capacity; ++i) {
+			if (auto future = pool.trySubmit([]() { work(100us); })) {
+				futures.push_back(std::move(*future));
+				++accepted;
+			}
+		}
+		for (auto& future : futures)
+			future.get();
+		assert(accepted >= bound.capacity && accepted < 2 * bound.capacity);
+	}
+}
+
+// Delayed tasks fall due while a bounded queue is full
+// The timer thread neither waits for room nor runs the tasks: they are retried until the workers drain the queue
+void benchmarkTimersBackpressure(const char* name, OverflowPolicy overflow) {
+	constexpr size_t capacity{8};
+	constexpr size_t numTimers{100};
+	ThreadPool pool(1, {}, {}, {}, QueueBound{ .capacity = capacity, .overflow = overflow });
+	std::atomic<bool> release{ false };
+	pool.post([&release]() {
+		while (!release.load())
+			std::this_thread::sleep_for(1ms);
+	});
+	// The worker is held, so the queue fills up
+	while (pool.tryPost([]() {}))
+		;
+	std::atomic<size_t> ran{0}, ranOffWorker{0};
+	for (size_t i = 0; i < numTimers; ++i) {
+		pool.postAfter(1ms, [&pool, &ran, &ranOffWorker]() {
+			if (!pool.isWorkerThread())
+				ranOffWorker.fetch_add(1);
+			ran.fetch_add(1);
+		});
+	}
+	auto farTimer = pool.postAfter(1s, []() {});
+	std::this_thread::sleep_for(20ms);
+	size_t ranWhileFull = ran.load();
+	assert(ranWhileFull == 0);
+	// The timer thread is not stuck on the full queue, so timers are still scheduled, fired and cancelled
+	auto [timer, future] = pool.submitAfter(1ms, []() { return 0; });
+	[[maybe_unused]] bool cancelled = pool.cancelTimer(farTimer);
+	assert(cancelled);
+	release.store(true);
+	[[maybe_unused]] int result = future.get();
+	assert(result == 0);
+	while (ran.load() < numTimers)
+		std::this_thread::sleep_for(1ms);
+	assert(ranOffWorker.load() == 0);
+	std::cout << name << " with timers: " << ranWhileFull << " delayed tasks ran while the queue was full, " << ran.load() << " after it drained, "
+		<< ranOffWorker.load() << " off the workers\n";
+}
+
+// A client with 500 queued subtasks disconnects shortly after submitting them
+// The group's stop source cancels every subtask that has not started, and the running ones stop cooperatively
+void benchmarkCancellation() {
+	constexpr size_t numTasks{500};
+	ThreadPool pool(2);
+	std::stop_source client;
+	std::atomic<size_t> started{0}, stoppedEarly{0};
+	std::vector<std::future<void>> futures;
+	for (size_t i = 0; i < numTasks; ++i) {
+		futures.emplace_back(pool.submit([&started, &stoppedEarly](std::stop_token token) {
+			++started;
+			for (int step = 0; step < 10; ++step) {
+				if (token.stop_requested()) {
+					++stoppedEarly;
+					return;
+				}
+				work(100us);
+			}
+		}, client.get_token()));
+	}
+	std::this_thread::sleep_for(20ms);
+	auto t1 = std::chrono::steady_clock::now();
+	client.request_stop();
+	size_t cancelled = 0;
+	for (auto& future : futures) {
+		try {
+			future.get();
+		}
+		catch (const TaskCancelled&) {
+			++cancelled;
+		}
+	}
+	auto t2 = std::chrono::steady_clock::now();
+	assert(cancelled + started.load() == numTasks);
+	std::cout << "cancellation: " << started.load() << " started, " << stoppedEarly.load() << " stopped early, " << cancelled << " cancelled, all futures ready "
+		<< std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count() << "us after the stop request\n";
+
+	// Callables that do not take the token are only cancelled before they start
+	std::stop_source source;
+	source.request_stop();
+	auto skipped = pool.submit([]() { return 1; }, source.get_token(), Priority::High);
+	try {
+		skipped.get();
+		assert(false);
+	}
+	catch (const TaskCancelled& e) {
+		std::cout << "cancelled before it started: " << e.what() << "\n";
+	}
+	[[maybe_unused]] int result = pool.submit([]() { return 1; }, std::stop_token{}).get();
+	assert(result == 1);
+}
+
+// Print the metrics of a pool
+void printMetrics(const PoolMetrics& metrics) {
+	auto total = metrics.total();
+	auto ms = [](std::chrono::nanoseconds time) { return std::chrono::duration_cast<std::chrono::milliseconds>(time).count(); };
+	std::cout << "  " << total.tasksExecuted << " tasks executed by";
+	for (const auto& worker : metrics.workers)
+		std::cout << " " << worker.tasksExecuted;
+	std::cout << ", queued:";
+	for (size_t depth : metrics.injectorDepth)
+		std::cout << " " << depth;
+	std::cout << "\n  spin " << ms(total.spinTime) << "ms, yield " << ms(total.yieldTime) << "ms, park " << ms(total.parkTime) << "ms (" << total.parks << " parks)\n";
+	auto us = [](std::chrono::nanoseconds time) { return std::chrono::duration<double, std::micro>(time).count(); };
+	std::cout << "  queue wait p50 " << us(metrics.queueWait.percentile(0.5)) << "us, p99 " << us(metrics.queueWait.percentile(0.99)) << "us"
+		<< " / run time p50 " << us(metrics.runTime.percentile(0.5)) << "us, p99 " << us(metrics.runTime.percentile(0.99)) << "us, max " << us(metrics.runTime.max()) << "us\n";
+}
+
+// Cost of the metrics on the post path and what a snapshot reports
+void benchmarkMetrics() {
+	constexpr size_t numTasks{100000};
+	ThreadPool pool(4);
+	std::atomic<size_t> counter{0};
+	auto smallTask = [&counter]() { counter.fetch_add(1, std::memory_order_relaxed); };
+	for (bool timing : { false, true }) {
+		pool.setTaskTiming(timing);
+		counter = 0;
+		auto t1 = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < numTasks; ++i)
+			pool.post(smallTask);
+		while (counter.load() < numTasks)
+			std::this_thread::yield();
+		auto t2 = std::chrono::steady_clock::now();
+		std::cout << "post with task timing " << (timing ? "on: " : "off: ") << std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count() << "ms\n";
+	}
+
+	// Tasks of mixed length, with an idle period after them
+	pool.submitN(200, [](size_t i) { work(std::chrono::microseconds(i % 10 == 0 ? 1000 : 50)); }).get();
+	std::this_thread::sleep_for(50ms);
+	auto metrics = pool.snapshot();
+	assert(metrics.total().tasksExecuted == 2 * numTasks + 200);
+	assert(metrics.queueWait.count() == numTasks + 200 && metrics.runTime.count() == numTasks + 200);
+	assert(metrics.runTime.max() >= 875us);
+	printMetrics(metrics);
+}
+
+// Several external threads post small tasks at once. Compares the mutex-protected lanes with the lock-free ring
+void benchmarkBackend(QueueBackend backend) {
+	constexpr size_t numProducers{4};
+	constexpr size_t numTasks{250000};
+	ThreadPool pool(4, {}, {}, {}, QueueBound{ .capacity = 1 << 16 }, backend);
+	std::atomic<size_t> counter{0};
+	auto t1 = std::chrono::steady_clock::now();
+	{
+		std::vector<std::jthread> producers;
+		for (size_t p = 0; p < numProducers; ++p) {
+			producers.emplace_back([&pool, &counter]() {
+				for (size_t i = 0; i < numTasks; ++i)
+					pool.post([&counter]() { counter.fetch_add(1, std::memory_order_relaxed); });
+			});
+		}
+	}
+	while (counter.load() < numProducers * numTasks)
+		std::this_thread::yield();
+	auto t2 = std::chrono::steady_clock::now();
+	std::cout << (backend == QueueBackend::Ring ? "ring" : "priority lanes") << ": " << numProducers << " producers posted "
+		<< numProducers * numTasks << " tasks in " << std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count() << "ms\n";
+}
+
 int main() {
 	// Create a thread pool
 	ThreadPool pool;
@@ -97,5 +572,129 @@ int main() {
 	5
 	*/
 
+	// Compare the old always-yielding workers with the default spin-then-park strategy
+	benchmarkIdle("yield", IdleStrategy{ .spinCount = 0, .yieldCount = 0, .park = false });
+	benchmarkIdle("spin-yield-park", IdleStrategy{});
+
+	/* Possible result:
+	yield: idle CPU 98.5489% of one core, wakeup latency p50 9us, p99 58us
+	spin-yield-park: idle CPU 0.00669891% of one core, wakeup latency p50 11us, p99 43us
+	*/
+
+	// Count heap allocations on the submit path
+	benchmarkSubmit();
+
+	/* Possible result:
+	Task: 0 allocations per task
+	post: 0 allocations per task, 17ms
+	submit: 2 allocations per task, 66ms
+	*/
+
+	// One lock acquisition and one wakeup round per batch
+	benchmarkBulk();
+
+	/* Possible result:
+	submit one by one: 56ms, submitN: 21ms
+	submitN exception: task 3 failed
+	*/
+
+	// Latency critical tasks no longer wait behind a backlog of bulk jobs
+	benchmarkPriority(false);
+	benchmarkPriority(true);
+
+	/* Possible result (single core machine):
+	single lane / interactive p50 474.841ms, p99 660.228ms / regular p50 474.892ms, p99 660.278ms / background p50 375.553ms, p99 666.281ms
+	priority lanes / interactive p50 0.207ms, p99 1.212ms / regular p50 0.006ms, p99 0.943ms / background p50 465.521ms, p99 737.372ms
+	*/
+
+	// Grow under load and shrink when idle
+	benchmarkAutoscaling();
+
+	/* Possible result (single core machine):
+	autoscaling: 1 thread, 8 threads during a 748ms burst, 1 thread 1404ms after it
+	*/
+
+	// Delayed and periodic tasks on one timer thread
+	benchmarkTimers();
+
+	/* Possible result (single core machine):
+	timers: schedule 180ns, cancel 59ns, 500000 cancelled, 500000 fired
+	submitAfter(20ms): ran 464us late
+	submitEvery(10ms): 10 runs in 105ms
+	*/
+
+	// Bound the memory held by queued tasks when the producer outpaces the workers
+	benchmarkBackpressure("unbounded", QueueBound{});
+	benchmarkBackpressure("block", QueueBound{ .capacity = 64, .overflow = OverflowPolicy::Block });
+	benchmarkBackpressure("run inline", QueueBound{ .capacity = 64, .overflow = OverflowPolicy::RunInline });
+	benchmarkBackpressure("drop oldest", QueueBound{ .capacity = 64, .overflow = OverflowPolicy::DropOldest });
+	benchmarkBackpressure("ring block", QueueBound{ .capacity = 64, .overflow = OverflowPolicy::Block }, QueueBackend::Ring);
+	benchmarkBackpressure("ring drop oldest", QueueBound{ .capacity = 64, .overflow = OverflowPolicy::DropOldest }, QueueBackend::Ring);
+
+	/* Possible result (single core machine):
+	unbounded: peak queue 2000, submitted in 0ms, 0 ran inline, 0 dropped
+	block: peak queue 64, submitted in 201ms, 0 ran inline, 0 dropped
+	run inline: peak queue 64, submitted in 194ms, 668 ran inline, 0 dropped
+	drop oldest: peak queue 64, submitted in 0ms, 0 ran inline, 1936 dropped
+	ring block: peak queue 64, submitted in 197ms, 0 ran inline, 0 dropped
+	ring drop oldest: peak queue 64, submitted in 0ms, 0 ran inline, 1936 dropped
+	*/
+
+	// Timers posting to a full queue
+	benchmarkTimersBackpressure("block", OverflowPolicy::Block);
+	benchmarkTimersBackpressure("run inline", OverflowPolicy::RunInline);
+
+	/* Possible result (single core machine):
+	block with timers: 0 delayed tasks ran while the queue was full, 100 after it drained, 0 off the workers
+	run inline with timers: 0 delayed tasks ran while the queue was full, 100 after it drained, 0 off the workers
+	*/
+
+	// Stop the queued and running tasks of a group
+	benchmarkCancellation();
+
+	/* Possible result (single core machine):
+	cancellation: 23 started, 2 stopped early, 477 cancelled, all futures ready 1624us after the stop request
+	cancelled before it started: task cancelled
+	*/
+
+	// Lock-free queue backend
+	benchmarkBackend(QueueBackend::PriorityLanes);
+	benchmarkBackend(QueueBackend::Ring);
+
+	/* Possible result (single core machine):
+	priority lanes: 4 producers posted 1000000 tasks in 199ms
+	ring: 4 producers posted 1000000 tasks in 83ms
+	*/
+
+	// Per-worker counters and latency histograms
+	benchmarkMetrics();
+
+	/* Possible result (single core machine):
+	post with task timing off: 20ms
+	post with task timing on: 29ms
+	  200200 tasks executed by 34357 33521 90374 41948, queued: 0 0 0 0
+	  spin 0ms, yield 129ms, park 0ms (4 parks)
+	  queue wait p50 4194.3us, p99 5767.17us / run time p50 0.048us, p99 0.072us, max 12582.9us
+	*/
+
+	// A task with a close deadline overtakes the queued tasks of every lane
+	ThreadPool busyPool(2);
+	std::atomic<bool> release{false};
+	std::atomic<int> blocked{0};
+	for (size_t i = 0; i < 2; ++i)
+		busyPool.post([&release, &blocked]() { ++blocked; while (!release.load()) std::this_thread::yield(); });
+	while (blocked.load() < 2)
+		std::this_thread::yield();
+	std::atomic<int> finished{0};
+	std::vector<std::future<void>> queued;
+	for (int i = 0; i < 100; ++i)
+		queued.emplace_back(busyPool.submit([&finished]() { ++finished; }, Priority::High));
+	auto urgent = busyPool.submitBefore([&finished]() { return finished.load(); }, std::chrono::steady_clock::now());
+	release = true;
+	[[maybe_unused]] int finishedBefore = urgent.get();
+	assert(finishedBefore == 0);
+	for (auto& future : queued)
+		future.get();
+
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,136 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <type_traits>
+
+// Lock-free work-stealing deque (Chase-Lev)
+// Memory orders follow Le et al., "Correct and Efficient Work-Stealing for Weak Memory Models" (PPoPP 2013)
+// Only the owner thread may call push() and tryPop(); they work on the bottom and are wait-free
+// Any thread may call trySteal(); thieves take from the top with a CAS
+// The ring buffer grows when full. Old buffers are kept until the deque is destroyed
+// because a thief may still be reading them
+// T must be trivially copyable (e.g. a pointer)
+template <class T>
+class WSDeque
+{
+	static_assert(std::is_trivially_copyable_v<T>, "WSDeque only stores trivially copyable types");
+private:
+	// Ring buffer with a power of 2 capacity
+	struct Array {
+		int64_t capacity;
+		int64_t mask;
+		std::unique_ptr<std::atomic<T>[]> data;
+		explicit Array(int64_t capacity_)
+			: capacity(capacity_), mask(capacity_ - 1), data(new std::atomic<T>[capacity_]) {}
+		// Acquire/release on the slots makes whatever an item points to visible to the thread that takes it
+		T get(int64_t index) const { return data[index & mask].load(std::memory_order_acquire); }
+		void put(int64_t index, T item) { data[index & mask].store(item, std::memory_order_release); }
+	};
+	alignas(64) std::atomic<int64_t> m_top{ 0 }; // Thieves steal from here
+	alignas(64) std::atomic<int64_t> m_bottom{ 0 }; // The owner pushes and pops here
+	std::atomic<Array*> m_array;
+	std::vector<std::unique_ptr<Array>> m_arrays; // Current and retired buffers (owner only)
+public:
+	// Capacity is rounded up to a power of 2
+	explicit WSDeque(size_t capacity = 1024);
+	WSDeque(const WSDeque&) = delete;
+	WSDeque& operator=(const WSDeque&) = delete;
+	// Push an item to the bottom (owner only)
+	void push(T item);
+	// Pop the most recently pushed item (owner only)
+	bool tryPop(T& result);
+	// Steal the least recently pushed item (any thread)
+	// Returns false if the deque is empty or another thread won the race for the item
+	bool trySteal(T& result);
+	// Approximate number of items (exact if called by the owner while no thief is active)
+	size_t size() const;
+	bool empty() const;
+private:
+	// Replace the full buffer with a buffer twice as large (owner only)
+	Array* grow(Array* array, int64_t top, int64_t bottom);
+};
+
+template <class T>
+WSDeque<T>::WSDeque(size_t capacity) {
+	int64_t roundedCapacity = 1;
+	while (roundedCapacity < static_cast<int64_t>(capacity))
+		roundedCapacity <<= 1;
+	m_arrays.emplace_back(new Array(roundedCapacity));
+	m_array.store(m_arrays.back().get(), std::memory_order_relaxed);
+}
+
+template <class T>
+void WSDeque<T>::push(T item) {
+	int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+	int64_t top = m_top.load(std::memory_order_acquire);
+	Array* array = m_array.load(std::memory_order_relaxed);
+	if (bottom - top > array->capacity - 1)
+		array = grow(array, top, bottom);
+	array->put(bottom, item);
+	std::atomic_thread_fence(std::memory_order_release);
+	m_bottom.store(bottom + 1, std::memory_order_relaxed);
+}
+
+template <class T>
+bool WSDeque<T>::tryPop(T& result) {
+	int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+	Array* array = m_array.load(std::memory_order_relaxed);
+	m_bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t top = m_top.load(std::memory_order_relaxed);
+	if (top > bottom) {
+		// Empty
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return false;
+	}
+	T item = array->get(bottom);
+	if (top == bottom) {
+		// Last item: race against thieves
+		bool won = m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		if (!won)
+			return false;
+	}
+	result = item;
+	return true;
+}
+
+template <class T>
+bool WSDeque<T>::trySteal(T& result) {
+	int64_t top = m_top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t bottom = m_bottom.load(std::memory_order_acquire);
+	if (top >= bottom)
+		return false;
+	Array* array = m_array.load(std::memory_order_acquire);
+	T item = array->get(top);
+	if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return false;
+	result = item;
+	return true;
+}
+
+template <class T>
+size_t WSDeque<T>::size() const {
+	int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+	int64_t top = m_top.load(std::memory_order_relaxed);
+	return bottom > top ? static_cast<size_t>(bottom - top) : 0;
+}
+
+template <class T>
+bool WSDeque<T>::empty() const {
+	return size() == 0;
+}
+
+template <class T>
+typename WSDeque<T>::Array* WSDeque<T>::grow(Array* array, int64_t top, int64_t bottom) {
+	auto newArray = std::make_unique<Array>(array->capacity * 2);
+	for (int64_t i = top; i < bottom; ++i)
+		newArray->put(i, array->get(i));
+	Array* result = newArray.get();
+	m_arrays.emplace_back(std::move(newArray));
+	m_array.store(result, std::memory_order_release);
+	return result;
+}
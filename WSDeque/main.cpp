@@ -0,0 +1,85 @@
+#include "WSDeque.hpp"
+#include "TSDeque.hpp"
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cassert>
+#include <latch>
+
+constexpr size_t numThieves{3};
+constexpr int numItems{1000000};
+
+// The owner pushes all items and pops every other one while thieves steal from the other end
+// Returns how many times each item was taken
+template <class Push, class Pop, class Steal>
+std::vector<int> run(Push push, Pop pop, Steal steal, long long& elapsedMs) {
+	std::vector<std::atomic<int>> taken(numItems);
+	std::atomic<int> remaining{numItems};
+	std::latch latch{numThieves + 1};
+	auto start = std::chrono::steady_clock::now();
+	{
+		std::vector<std::jthread> thieves;
+		for (size_t i = 0; i < numThieves; ++i) {
+			thieves.emplace_back([&]() {
+				latch.arrive_and_wait();
+				int item;
+				while (remaining.load(std::memory_order_relaxed) > 0) {
+					if (steal(item)) {
+						taken[item]++;
+						remaining--;
+					}
+				}
+			});
+		}
+		latch.arrive_and_wait();
+		int item;
+		for (int i = 0; i < numItems; ++i) {
+			push(i);
+			if (i % 2 && pop(item)) {
+				taken[item]++;
+				remaining--;
+			}
+		}
+		while (remaining.load() > 0) {
+			if (pop(item)) {
+				taken[item]++;
+				remaining--;
+			}
+		}
+	}
+	elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+	std::vector<int> result;
+	for (auto& count : taken)
+		result.push_back(count.load());
+	return result;
+}
+
+int main() {
+	// Start with a small capacity so that the buffer grows while thieves are active
+	WSDeque<int> wsDeque(16);
+	TSDeque<int> tsDeque;
+	long long wsElapsed, tsElapsed;
+
+	auto wsCounts = run(
+		[&](int item) { wsDeque.push(item); },
+		[&](int& item) { return wsDeque.tryPop(item); },
+		[&](int& item) { return wsDeque.trySteal(item); },
+		wsElapsed);
+	auto tsCounts = run(
+		[&](int item) { tsDeque.push(item); },
+		[&](int& item) { return tsDeque.tryPopBack(item); },
+		[&](int& item) { return tsDeque.tryPop(item); },
+		tsElapsed);
+
+	// Check that every item was taken exactly once
+	for (int i = 0; i < numItems; ++i) {
+		assert(wsCounts[i] == 1);
+		assert(tsCounts[i] == 1);
+	}
+	std::cout << "WSDeque: " << wsElapsed << "ms\n";
+	std::cout << "TSDeque: " << tsElapsed << "ms\n";
+
+	return 0;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <atomic>
+#include <utility>
+#include <chrono>
+#include "Task.hpp"
+
+class TaskCache;
+
+// Node that carries a Task through a WSDeque, which can only store pointers
+struct TaskNode
+{
+	Task task;
+	TaskNode* next{ nullptr };
+	TaskCache* owner{ nullptr }; // nullptr if the submitter owns the node. See WSThreadPool::postNode()
+	std::chrono::steady_clock::time_point enqueued{}; // Set only while task timing is enabled
+};
+
+// Free list of TaskNode objects owned by one worker
+// Only the owner allocates. A node goes back to the owner's private list if the owner releases it
+// and to a lock-free list if another thread (e.g. a thief) releases it,
+// so pushing to a worker's deque does not allocate once the cache is warm
+class TaskCache
+{
+private:
+	TaskNode* m_free{ nullptr }; // Accessed by the owner only
+	std::atomic<TaskNode*> m_returned{ nullptr }; // Nodes released by other threads
+public:
+	TaskCache() = default;
+	TaskCache(const TaskCache&) = delete;
+	TaskCache& operator=(const TaskCache&) = delete;
+	~TaskCache();
+	// Get a node holding the given task (owner only)
+	TaskNode* allocate(Task&& task, std::chrono::steady_clock::time_point enqueued = {});
+	// Take the task out of the node and give the node back to its owner. A node without an owner is left to the submitter
+	// 'current' is the cache of the calling thread or nullptr if it has none
+	static Task release(TaskNode* node, TaskCache* current);
+private:
+	static void deleteNodes(TaskNode* node);
+};
+
+inline TaskCache::~TaskCache() {
+	deleteNodes(m_free);
+	deleteNodes(m_returned.load(std::memory_order_acquire));
+}
+
+inline TaskNode* TaskCache::allocate(Task&& task, std::chrono::steady_clock::time_point enqueued) {
+	// Reuse nodes released by other threads once the private list runs out
+	if (!m_free)
+		m_free = m_returned.exchange(nullptr, std::memory_order_acquire);
+	TaskNode* node = m_free;
+	if (node)
+		m_free = node->next;
+	else {
+		node = new TaskNode();
+		node->owner = this;
+	}
+	node->task = std::move(task);
+	node->enqueued = enqueued;
+	return node;
+}
+
+inline Task TaskCache::release(TaskNode* node, TaskCache* current) {
+	Task task{ std::move(node->task) };
+	TaskCache* owner = node->owner;
+	if (!owner)
+		return task;
+	if (owner == current) {
+		node->next = owner->m_free;
+		owner->m_free = node;
+	}
+	else {
+		// The owner only ever takes the whole list, so pushing with a CAS is free of ABA problems
+		node->next = owner->m_returned.load(std::memory_order_relaxed);
+		while (!owner->m_returned.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed));
+	}
+	return task;
+}
+
+inline void TaskCache::deleteNodes(TaskNode* node) {
+	while (node) {
+		TaskNode* next = node->next;
+		delete node;
+		node = next;
+	}
+}
@@ -1,19 +1,35 @@
 #include "WSThreadPool.hpp"
+#include <algorithm>
 
+// Per-thread xorshift random number generator for victim selection
+static uint32_t nextRandom() {
+	thread_local uint32_t state = static_cast<uint32_t>(std::hash<std::thread::id>{}(std::this_thread::get_id())) | 1u;
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
 
 // Constructor: Initialize the thread pool with a specified number of threads
 // Leave 2 cores unused for other applications or the OS
-WSThreadPool::WSThreadPool(size_t numThreads)
-	: m_numThreads(numThreads)
+WSThreadPool::WSThreadPool(size_t numThreads, IdleStrategy idleStrategy, StealPolicy stealPolicy, size_t numMainQueues, size_t maxThreads,
+	Placement placement)
+	: m_numThreads(numThreads), m_idleStrategy(idleStrategy), m_stealPolicy(stealPolicy)
 {
-	m_queues.reserve(numThreads);
-	for (size_t i = 0; i < numThreads; ++i)
-		m_queues.emplace_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
-	m_threads.reserve(numThreads);
+	numMainQueues = numMainQueues ? numMainQueues : std::max<size_t>(numThreads, 1);
+	m_mainQueues.reserve(numMainQueues);
+	for (size_t i = 0; i < numMainQueues; ++i)
+		m_mainQueues.emplace_back(std::make_unique<Shard>());
+	maxThreads = std::max(maxThreads ? maxThreads : std::thread::hardware_concurrency(), std::max<size_t>(numThreads, 1));
+	m_workers.reserve(maxThreads);
+	for (size_t i = 0; i < maxThreads; ++i)
+		m_workers.emplace_back(std::make_unique<Worker>(this, i));
+	placeWorkers(placement);
+	m_threads.resize(maxThreads);
 	try
 	{
 		for (size_t i = 0; i < numThreads; ++i)
-			m_threads.emplace_back(std::bind(&WSThreadPool::work, this, i, std::placeholders::_1));
+			m_threads[i] = std::jthread(std::bind(&WSThreadPool::work, this, i, std::placeholders::_1));
 	}
 	catch (const std::exception&)
 	{
@@ -24,8 +40,9 @@ WSThreadPool::WSThreadPool(size_t numThreads)
 
 // Run a pending task if any
 void WSThreadPool::runPendingTask() {
-	std::function<void()> task;
-	if (getWork(task))
+	Task task;
+	Clock::time_point enqueued;
+	if (getWork(task, enqueued))
 		task();
 	else
 		std::this_thread::yield();
@@ -33,42 +50,310 @@ void WSThreadPool::runPendingTask() {
 
 // Destructor: Stop all threads in the pool
 WSThreadPool::~WSThreadPool() {
+	stopAutoscaling();
+	// No more delayed tasks are posted once the timer thread has stopped
+	m_timers.reset();
 	stopAllThreads();
+	m_threads.clear();
+	// Destroy the tasks left in the queues while every TaskCache is still alive
+	// A queue may hold nodes of other workers' caches after a steal-half
+	for (auto& worker : m_workers) {
+		TaskNode* node;
+		while (worker->queue.tryPop(node))
+			TaskCache::release(node, nullptr);
+		if ((node = worker->lifoSlot.exchange(nullptr)))
+			TaskCache::release(node, nullptr);
+	}
+}
+
+// Start or stop workers until there are 'numThreads'
+void WSThreadPool::resize(size_t numThreads) {
+	numThreads = std::clamp<size_t>(numThreads, 1, m_workers.size());
+	std::scoped_lock lock{m_resizeMutex};
+	size_t current = m_numThreads.load(std::memory_order_relaxed);
+	// New workers reuse the queues and caches of retired ones
+	for (size_t i = current; i < numThreads; ++i) {
+		m_threads[i] = std::jthread(std::bind(&WSThreadPool::work, this, i, std::placeholders::_1));
+		m_numThreads.store(i + 1, std::memory_order_relaxed);
+	}
+	if (numThreads < current) {
+		// Thieves stop choosing the retiring workers as victims. Those who already did find their queues drained soon
+		m_numThreads.store(numThreads, std::memory_order_relaxed);
+		for (size_t i = numThreads; i < current; ++i)
+			m_threads[i].request_stop();
+		// Wake parked workers so that the retiring ones can see the stop request
+		m_idleEvent.notifyAll();
+		for (size_t i = numThreads; i < current; ++i)
+			m_threads[i].join();
+	}
+}
+
+// Timer wheel of the pool, created on first use
+TimerWheel& WSThreadPool::timers() {
+	std::call_once(m_timersFlag, [this]() { m_timers = std::make_unique<TimerWheel>(); });
+	return *m_timers;
+}
+
+// Resize the pool in the background according to the policy
+void WSThreadPool::startAutoscaling(ScalingPolicy policy) {
+	auto autoscaler = std::make_unique<Autoscaler<WSThreadPool>>(*this, policy);
+	{
+		std::scoped_lock lock{m_resizeMutex};
+		m_autoscaler.swap(autoscaler);
+	}
+	// The previous autoscaler is joined outside the lock because it may be waiting for the lock in resize()
+}
+
+void WSThreadPool::stopAutoscaling() {
+	std::unique_ptr<Autoscaler<WSThreadPool>> autoscaler;
+	{
+		std::scoped_lock lock{m_resizeMutex};
+		m_autoscaler.swap(autoscaler);
+	}
 }
 
+// Number of tasks in all queues
+size_t WSThreadPool::queueSize() const {
+	size_t size = 0;
+	for (const auto& shard : m_mainQueues)
+		size += static_cast<size_t>(std::max<int64_t>(shard->size.load(std::memory_order_relaxed), 0));
+	for (const auto& worker : m_workers)
+		size += worker->queue.size() + (worker->lifoSlot.load(std::memory_order_relaxed) ? 1 : 0);
+	return size;
+}
+
+// Number of tasks in the calling worker's own queue and LIFO slot
+size_t WSThreadPool::localQueueSize() const {
+	Worker* local = localWorker();
+	if (!local)
+		return 0;
+	return local->queue.size() + (local->lifoSlot.load(std::memory_order_relaxed) ? 1 : 0);
+}
+
+// Pin the workers to CPUs and find the neighbours of each worker
+void WSThreadPool::placeWorkers(const Placement& placement) {
+	if (!placement.pinWorkers)
+		return;
+	auto cpus = CpuTopology::detect().placementOrder();
+	if (cpus.empty())
+		return;
+	for (auto& worker : m_workers)
+		worker->cpu = static_cast<int>(cpus[worker->index % cpus.size()].id);
+	if (!placement.localStealFirst)
+		return;
+	for (auto& worker : m_workers) {
+		unsigned domain = cpus[worker->index % cpus.size()].cacheDomain;
+		for (auto& other : m_workers) {
+			if (other != worker && cpus[other->index % cpus.size()].cacheDomain == domain)
+				worker->neighbours.push_back(other->index);
+		}
+		// Nobody to prefer if every worker shares the cache
+		if (worker->neighbours.size() + 1 == m_workers.size())
+			worker->neighbours.clear();
+	}
+}
 
 // Worker function for each thread
 void WSThreadPool::work(size_t threadIndex, std::stop_token token) {
-	m_threadIndex = threadIndex;
-	m_localQueue = m_queues[threadIndex].get();
+	Worker& worker = *m_workers[threadIndex];
+	if (worker.cpu >= 0)
+		pinCurrentThread(static_cast<unsigned>(worker.cpu));
+	s_currentWorker = &worker;
+	WorkerCounters& counters = worker.counters;
+	Idler idler{m_idleStrategy, m_idleEvent, &counters};
 	while (!token.stop_requested()) {
-		std::function<void()> task;
-		if (getWork(task))
-			task();
+		Task task;
+		Clock::time_point enqueued;
+		if (getWork(task, enqueued)) {
+			// Tasks submitted while timing was off have no submission time
+			if (enqueued != Clock::time_point{} && m_taskTiming.load(std::memory_order_relaxed)) {
+				auto start = Clock::now();
+				counters.queueWait.record(start - enqueued);
+				task();
+				counters.runTime.record(Clock::now() - start);
+			}
+			else
+				task();
+			bumpCounter(counters.tasksExecuted);
+			idler.reset();
+		}
 		else
-			std::this_thread::yield();
+			idler.idle([this]() { return hasWork(); }, token);
+	}
+	// Nobody else pops the queue of a retired worker
+	redistribute(worker);
+	s_currentWorker = nullptr;
+}
+
+// Move the tasks in a retiring worker's queue and LIFO slot to the main queue
+void WSThreadPool::redistribute(Worker& worker) {
+	Shard& shard = *m_mainQueues[worker.index % m_mainQueues.size()];
+	size_t moved = 0;
+	TaskNode* node = worker.lifoSlot.exchange(nullptr, std::memory_order_acq_rel);
+	// Newest task first, like the order the worker would have run them in
+	while (node || worker.queue.tryPop(node)) {
+		auto enqueued = node->enqueued;
+		shard.push(QueuedTask{ TaskCache::release(node, &worker.cache), enqueued });
+		shard.size.fetch_add(1, std::memory_order_relaxed);
+		node = nullptr;
+		++moved;
 	}
+	m_idleEvent.notify(moved);
 }
 
 // Take or steal an available task
-bool WSThreadPool::getWork(std::function<void()>& task) {
-	// Search the local queue
-	if (m_localQueue && m_localQueue->tryPop(task))
-		return true;
-	// Search the main queue
-	if (m_mainQueue.tryPop(task))
-		return true;
-	// Steal a work from other queues
-	for (size_t i = 1; i < m_numThreads; ++i) {
-		size_t nextIndex = (m_threadIndex + i) % m_numThreads;
-		if (m_queues[nextIndex]->tryPopBack(task))
+bool WSThreadPool::getWork(Task& task, Clock::time_point& enqueued) {
+	Worker* local = localWorker();
+	TaskNode* node;
+	if (local) {
+		// Search the LIFO slot. Give the deque a turn after 'maxLifoRuns' slot tasks in a row to avoid starving older tasks
+		if (m_stealPolicy.lifoSlot && local->lifoRuns < m_stealPolicy.maxLifoRuns && takeLifoSlot(*local, local, task, enqueued)) {
+			++local->lifoRuns;
+			return true;
+		}
+		local->lifoRuns = 0;
+		// Search the local queue (newest task first)
+		if (local->queue.tryPop(node)) {
+			enqueued = node->enqueued;
+			task = TaskCache::release(node, &local->cache);
+			return true;
+		}
+		if (m_stealPolicy.lifoSlot && takeLifoSlot(*local, local, task, enqueued))
+			return true;
+	}
+	// Search the main queue shards, starting at a random one
+	size_t numShards = m_mainQueues.size();
+	size_t start = nextRandom() % numShards;
+	for (size_t i = 0; i < numShards; ++i) {
+		Shard& shard = *m_mainQueues[(start + i) % numShards];
+		QueuedTask queued;
+		if (shard.size.load(std::memory_order_relaxed) > 0 && shard.tryPop(queued)) {
+			shard.size.fetch_sub(1, std::memory_order_relaxed);
+			task = std::move(queued.task);
+			enqueued = queued.enqueued;
+			return true;
+		}
+	}
+	// Steal a work from randomly chosen victims (oldest task first)
+	size_t numThreads = m_numThreads.load(std::memory_order_relaxed);
+	// Probe the workers that share the thief's cache first. Their tasks' data is more likely to be in that cache
+	if (local && !local->neighbours.empty()) {
+		size_t numNeighbours = local->neighbours.size();
+		size_t offset = nextRandom() % numNeighbours;
+		for (size_t i = 0; i < numNeighbours; ++i) {
+			size_t victimIndex = local->neighbours[(offset + i) % numNeighbours];
+			if (victimIndex < numThreads && stealFrom(*m_workers[victimIndex], local, task, enqueued))
+				return true;
+		}
+	}
+	size_t numVictims = local ? numThreads - 1 : numThreads;
+	if (numVictims == 0)
+		return false;
+	size_t maxAttempts = m_stealPolicy.maxAttempts ? m_stealPolicy.maxAttempts : numVictims;
+	for (size_t attempt = 0; attempt < maxAttempts; ++attempt) {
+		size_t victimIndex = nextRandom() % numVictims;
+		// Skip the local worker
+		if (local)
+			victimIndex = (local->index + 1 + victimIndex) % numThreads;
+		if (stealFrom(*m_workers[victimIndex], local, task, enqueued))
+			return true;
+	}
+	// Take another worker's LIFO slot as a last resort
+	if (m_stealPolicy.lifoSlot) {
+		for (auto& worker : m_workers) {
+			if (worker.get() != local && takeLifoSlot(*worker, local, task, enqueued))
+				return true;
+		}
+	}
+	return false;
+}
+
+// Take the task in the worker's LIFO slot if any
+bool WSThreadPool::takeLifoSlot(Worker& worker, Worker* taker, Task& task, Clock::time_point& enqueued) {
+	if (!worker.lifoSlot.load(std::memory_order_relaxed))
+		return false;
+	TaskNode* node = worker.lifoSlot.exchange(nullptr, std::memory_order_acq_rel);
+	if (!node)
+		return false;
+	enqueued = node->enqueued;
+	task = TaskCache::release(node, taker ? &taker->cache : nullptr);
+	return true;
+}
+
+// Steal from the given worker
+bool WSThreadPool::stealFrom(Worker& victim, Worker* thief, Task& task, Clock::time_point& enqueued) {
+	if (thief)
+		bumpCounter(thief->stealAttempts);
+	TaskNode* node;
+	if (!victim.queue.trySteal(node))
+		return false;
+	uint64_t stolen = 1;
+	// Move up to half of the remaining tasks to the thief's queue
+	// WSDeque can only hand out one task per CAS because the owner pops the other end without one,
+	// so the batch is taken with repeated steals from the same, already cached, victim
+	if (thief && m_stealPolicy.stealHalf) {
+		size_t batch = std::min(victim.queue.size() / 2, m_stealPolicy.maxBatch);
+		TaskNode* extra;
+		for (size_t i = 0; i < batch && victim.queue.trySteal(extra); ++i) {
+			thief->queue.push(extra);
+			++stolen;
+		}
+	}
+	if (thief) {
+		bumpCounter(thief->stealSuccesses);
+		bumpCounter(thief->tasksStolen, stolen);
+	}
+	enqueued = node->enqueued;
+	task = TaskCache::release(node, thief ? &thief->cache : nullptr);
+	return true;
+}
+
+// Check if any queue has a task
+bool WSThreadPool::hasWork() const {
+	for (const auto& shard : m_mainQueues) {
+		if (shard->size.load(std::memory_order_relaxed) > 0)
+			return true;
+	}
+	for (const auto& worker : m_workers) {
+		if (!worker->queue.empty() || worker->lifoSlot.load(std::memory_order_relaxed))
 			return true;
 	}
 	return false;
 }
 
+// Sum the steal counters of all workers
+StealStats WSThreadPool::getStealStats() const {
+	StealStats stats;
+	for (const auto& worker : m_workers) {
+		stats.attempts += worker->stealAttempts.load(std::memory_order_relaxed);
+		stats.successes += worker->stealSuccesses.load(std::memory_order_relaxed);
+		stats.tasksStolen += worker->tasksStolen.load(std::memory_order_relaxed);
+	}
+	return stats;
+}
+
+// Aggregate the per-worker counters
+PoolMetrics WSThreadPool::snapshot() const {
+	PoolMetrics metrics;
+	for (const auto& shard : m_mainQueues)
+		metrics.injectorDepth.push_back(static_cast<size_t>(std::max<int64_t>(shard->size.load(std::memory_order_relaxed), 0)));
+	for (const auto& worker : m_workers) {
+		WorkerMetrics& entry = metrics.workers.emplace_back();
+		entry.addCounters(worker->counters);
+		entry.queueDepth = worker->queue.size() + (worker->lifoSlot.load(std::memory_order_relaxed) ? 1 : 0);
+		entry.stealAttempts = worker->stealAttempts.load(std::memory_order_relaxed);
+		entry.stealSuccesses = worker->stealSuccesses.load(std::memory_order_relaxed);
+		entry.tasksStolen = worker->tasksStolen.load(std::memory_order_relaxed);
+		worker->counters.queueWait.addTo(metrics.queueWait);
+		worker->counters.runTime.addTo(metrics.runTime);
+	}
+	return metrics;
+}
+
 // Stop all threads in the pool
 void WSThreadPool::stopAllThreads() {
 	for (auto& thread : m_threads)
 		thread.request_stop();
+	// Wake parked workers so that they can see the stop request
+	m_idleEvent.notifyAll();
 }
\ No newline at end of file
@@ -5,28 +5,114 @@
 #include <type_traits>
 #include <vector>
 #include <memory>
-#include "TSDeque.hpp"
+#include <utility>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include "WSDeque.hpp"
+#include "IdleStrategy.hpp"
+#include "Task.hpp"
+#include "RingQueue.hpp"
+#include "Schedule.hpp"
+#include "TaskCache.hpp"
+#include "Autoscaler.hpp"
+#include "Topology.hpp"
+#include "TimerWheel.hpp"
+#include "Cancellation.hpp"
+#include "Metrics.hpp"
 
-// This code should be inside the class, but I couldn't find a way to do so...
-static thread_local TSDeque<std::function<void()>>* m_localQueue;
-static thread_local size_t m_threadIndex;
+// How workers look for tasks in other workers' queues
+struct StealPolicy
+{
+	unsigned maxAttempts{ 0 }; // Number of randomly chosen victims probed per search. 0 means one per other worker
+	bool stealHalf{ true }; // Move up to half of the victim's tasks to the thief's queue in one search
+	size_t maxBatch{ 32 }; // Upper bound on the tasks moved by one steal-half
+	// Keep the task a worker posted last in a per-worker slot that is checked before the worker's deque
+	// Thieves only take it after failing to find work in every deque, so cache-hot continuations stay on their worker
+	bool lifoSlot{ false };
+	unsigned maxLifoRuns{ 3 }; // Consecutive tasks taken from the slot before the deque gets a turn
+};
+
+// Work stealing counters summed over all workers
+struct StealStats
+{
+	uint64_t attempts{ 0 }; // Probes of a victim's queue
+	uint64_t successes{ 0 }; // Probes that got at least one task
+	uint64_t tasksStolen{ 0 }; // Tasks taken, including the extra tasks of steal-half batches
+	double successRate() const { return attempts ? static_cast<double>(successes) / attempts : 0.0; }
+};
 
-// Work stealing thread pool with distrubuted queues for each thread and a main queue
+// Work stealing thread pool with distrubuted queues for each thread and a sharded main queue
 class WSThreadPool
 {
 private:
-	using WorkQueue = TSDeque<std::function<void()>>;
-	size_t m_numThreads; // Number of threads in the thread pool
-	WorkQueue m_mainQueue;
-	std::vector<std::unique_ptr<WorkQueue>> m_queues;
-	std::vector<std::jthread> m_threads; // Vector to store thread objects
+	using Clock = std::chrono::steady_clock;
+	// Per-thread state
+	struct Worker {
+		const WSThreadPool* pool; // Pool that owns this worker
+		size_t index; // Index in m_workers
+		WSDeque<TaskNode*> queue; // Lock-free deque. Only the owner pushes and pops, other threads steal
+		TaskCache cache; // Recycles the nodes pushed to the queue
+		std::atomic<TaskNode*> lifoSlot{ nullptr }; // Task posted last if StealPolicy::lifoSlot is set
+		unsigned lifoRuns{ 0 }; // Consecutive tasks taken from the slot (owner only)
+		int cpu{ -1 }; // CPU the worker is pinned to. -1 if it is not pinned
+		std::vector<size_t> neighbours; // Workers that share this worker's cache domain. Probed first by steals
+		// Steal counters. Only the owner writes them
+		std::atomic<uint64_t> stealAttempts{ 0 };
+		std::atomic<uint64_t> stealSuccesses{ 0 };
+		std::atomic<uint64_t> tasksStolen{ 0 };
+		WorkerCounters counters;
+		Worker(const WSThreadPool* pool_, size_t index_) : pool(pool_), index(index_) {}
+	};
+	// Shard of the main queue. External submitters are spread over the shards by thread id
+	// Task in a shard with the time it was submitted. The time is set only while task timing is enabled
+	struct QueuedTask {
+		Task task;
+		Clock::time_point enqueued;
+	};
+	struct alignas(64) Shard {
+		std::mutex mutex;
+		RingQueue<QueuedTask> queue; // Held by value in reused slots, so a submission does not allocate once the shard has grown to its peak length
+		std::atomic<int64_t> size{ 0 }; // Lets workers skip empty shards without locking
+		void push(QueuedTask&& task) {
+			std::scoped_lock lock{mutex};
+			queue.push_back(std::move(task));
+		}
+		bool tryPop(QueuedTask& result) {
+			std::scoped_lock lock{mutex};
+			if (queue.empty())
+				return false;
+			result = std::move(queue.front());
+			queue.pop_front();
+			return true;
+		}
+	};
+	// Worker run by the calling thread, if it is a worker of any pool
+	// Keyed by pool through Worker::pool so that several pools can coexist. See localWorker()
+	static inline thread_local Worker* s_currentWorker{ nullptr };
+	std::atomic<size_t> m_numThreads; // Number of running workers. They are m_workers[0, m_numThreads)
+	std::vector<std::unique_ptr<Shard>> m_mainQueues; // Tasks submitted from outside the pool
+	// One worker per thread the pool can grow to. Never reallocated, so that thieves can index it while the pool is resized
+	std::vector<std::unique_ptr<Worker>> m_workers;
+	IdleStrategy m_idleStrategy; // What workers do when there is nothing to take or steal
+	StealPolicy m_stealPolicy;
+	EventCount m_idleEvent; // Idle workers park on this until a task is submitted
+	std::atomic<bool> m_taskTiming{ false };
+	std::vector<std::jthread> m_threads; // Thread of each worker. Not joinable for the workers that are not running
+	std::mutex m_resizeMutex; // Serializes resize() and startAutoscaling()
+	std::unique_ptr<Autoscaler<WSThreadPool>> m_autoscaler; // Set while autoscaling
+	std::once_flag m_timersFlag;
+	std::unique_ptr<TimerWheel> m_timers; // Created by the first delayed task
 public:
 	// Delete copy constructor and copy assignment operator
 	WSThreadPool(const WSThreadPool&) = delete;
 	WSThreadPool& operator=(const WSThreadPool&) = delete;
 	// Constructor: Initialize the thread pool with a specified number of threads
 	// Leave 2 cores unused for other applications or the OS
-	WSThreadPool(size_t numThreads = std::max(std::thread::hardware_concurrency() - 2, 1u));
+	// The main queue is split into 'numMainQueues' shards. 0 means one shard per thread
+	// resize() can grow the pool up to 'maxThreads' workers. 0 means the larger of 'numThreads' and the number of hardware threads
+	WSThreadPool(size_t numThreads = std::max(std::thread::hardware_concurrency(), 3u) - 2, IdleStrategy idleStrategy = {},
+		StealPolicy stealPolicy = {}, size_t numMainQueues = 0, size_t maxThreads = 0, Placement placement = {});
 	// Run a pending task if any
 	void runPendingTask();
 	// Destructor: Stop all threads in the pool
@@ -34,14 +120,98 @@ public:
 	// Submit a callable task to the thread pool and return a future for the result
 	template <class Func>
 	std::future<typename std::invoke_result<Func>::type> submit(Func func);
+	// Submit a callable task that is cancelled by a stop request on 'token'
+	// If stop is requested before a worker dequeues the task, the task is discarded without running and its future gets TaskCancelled
+	// func may take the token as its argument to stop cooperatively once it runs. Share one std::stop_source to cancel a group
+	template <class Func>
+	std::future<CancellableResult<Func>> submit(Func func, std::stop_token token);
+	// Submit a callable task without a future (fire-and-forget)
+	// No heap allocation is needed for the task if the callable fits in a Task
+	// The callable must not throw
+	template <class Func>
+	void post(Func func);
+	// Submit a callable task without a future to the main queue, even from a worker of this pool
+	// It runs after the tasks already queued there, so a task that requeues itself lets the others make progress
+	template <class Func>
+	void postToMainQueue(Func func);
+	// Submit the task held in a node that the caller owns, so that no node is taken from the worker's cache
+	// For objects that post the same work again and again and can embed its node. 'node->owner' must be nullptr
+	// The node must stay alive, and must not be posted again, until its task has started
+	void postNode(TaskNode* node);
+	// Awaitable that resumes the awaiting coroutine on a worker of this pool
+	// The coroutine is queued with postToMainQueue(), so coroutines that await it on a worker interleave
+	// instead of each running to completion in the worker's LIFO slot
+	ScheduleAwaiter<WSThreadPool> schedule() { return ScheduleAwaiter<WSThreadPool>(*this); }
+	// Submit a callable task once the delay has passed. Returns the timer, for cancelTimer(), and a future for the result
+	// The future gets std::future_errc::broken_promise if the timer is cancelled
+	// The first delayed task starts the pool's timer thread, which posts tasks to the pool when they are due
+	template <class Func>
+	std::pair<TimerWheel::TimerId, std::future<typename std::invoke_result<Func>::type>> submitAfter(TimerWheel::Clock::duration delay, Func func);
+	// Submit a callable task without a future once the delay has passed
+	template <class Func>
+	TimerWheel::TimerId postAfter(TimerWheel::Clock::duration delay, Func func);
+	// Submit a callable task every period, starting one period from now, until cancelTimer()
+	// The callable is shared by the runs. A run may overlap the next one if it takes longer than the period
+	template <class Func>
+	TimerWheel::TimerId submitEvery(TimerWheel::Clock::duration period, Func func);
+	// Cancel a delayed or periodic task. O(1). Returns false if it has already been posted to the pool (one-shot) or cancelled
+	bool cancelTimer(TimerWheel::TimerId id) { return timers().cancel(id); }
 	// Check if the given future is ready
 	template <class T>
 	static bool isFutureReady(std::future<T>& future);
+	// Sum the steal counters of all workers
+	StealStats getStealStats() const;
+	// Aggregate the per-worker counters. There is a worker entry for every worker slot up to maxThreads
+	// The injector depths are the main queue shards. Only the owner writes a worker's counters, so the task path has no shared writes
+	PoolMetrics snapshot() const;
+	// Record the queue wait and run time histograms. Off by default because it reads the clock on every submission and twice per task run
+	void setTaskTiming(bool enabled) { m_taskTiming.store(enabled, std::memory_order_relaxed); }
+	// Check if the calling thread is a worker of this pool
+	bool isWorkerThread() const { return localWorker() != nullptr; }
+	// Number of worker threads
+	size_t getNumThreads() const { return m_numThreads.load(std::memory_order_relaxed); }
+	// Start or stop workers until there are 'numThreads', clamped to [1, maxThreads]
+	// A retiring worker finishes its current task and moves the tasks left in its queue to the main queue
+	// Must not be called from a worker of this pool
+	void resize(size_t numThreads);
+	// Resize the pool in the background according to the policy. Replaces the previous policy if any
+	void startAutoscaling(ScalingPolicy policy = {});
+	void stopAutoscaling();
+	// Load measures used by the autoscaler
+	size_t queueSize() const;
+	size_t numIdleWorkers() const { return m_idleEvent.numWaiters(); }
+	// Number of tasks in the calling worker's own queue and LIFO slot. 0 if the calling thread is not a worker of this pool
+	// An empty local queue means there is nothing for idle workers to steal from this worker
+	size_t localQueueSize() const;
 private:
+	// Well-mixed hash of the calling thread's id, computed once per thread
+	static size_t threadHash() {
+		thread_local size_t hash = static_cast<size_t>((std::hash<std::thread::id>{}(std::this_thread::get_id()) * 0x9E3779B97F4A7C15ull) >> 32);
+		return hash;
+	}
+	// Worker run by the calling thread if it belongs to this pool, nullptr otherwise
+	Worker* localWorker() const {
+		return (s_currentWorker && s_currentWorker->pool == this) ? s_currentWorker : nullptr;
+	}
+	// Pin the workers to CPUs and find the neighbours of each worker
+	void placeWorkers(const Placement& placement);
 	// Worker function for each thread
 	void work(size_t threadIndex, std::stop_token token);
-	// Take or steal an available task
-	bool getWork(std::function<void()>& task);
+	// Take or steal an available task. 'enqueued' receives when the task was submitted, or a default time if it is unknown
+	bool getWork(Task& task, Clock::time_point& enqueued);
+	// Take the task in the worker's LIFO slot if any
+	bool takeLifoSlot(Worker& worker, Worker* taker, Task& task, Clock::time_point& enqueued);
+	// Steal from the given worker. Moves a batch to the thief's queue if steal-half is enabled
+	// 'thief' is nullptr if the calling thread is not a worker of this pool
+	bool stealFrom(Worker& victim, Worker* thief, Task& task, Clock::time_point& enqueued);
+	// Push a node to the calling worker's LIFO slot or deque and wake an idle worker
+	void pushLocal(Worker& worker, TaskNode* node);
+	// Move the tasks in a retiring worker's queue and LIFO slot to the main queue (owner only)
+	void redistribute(Worker& worker);
+	// Check if any queue has a task
+	bool hasWork() const;
+	// Timer wheel of the pool, created on first use
+	TimerWheel& timers();
 	// Stop all threads in the pool
 	void stopAllThreads();
 };
@@ -52,16 +222,89 @@ std::future<typename std::invoke_result<Func>::type> WSThreadPool::submit(Func f
 	using ResultType = typename std::invoke_result<Func>::type;
 	std::packaged_task<ResultType()> task{std::move(func)};
 	auto future{ task.get_future() };
-	// Wrap the packaged task with a lambda function to store it in the queue
-	if (m_localQueue)
-		m_localQueue->push([t = std::make_shared<decltype(task)>(std::move(task))]() { (*t)(); });
-	else
-		m_mainQueue.push([t = std::make_shared<decltype(task)>(std::move(task))]() { (*t)(); });
+	// std::packaged_task is move-only, so it is stored in the Task directly
+	post(std::move(task));
+	return future;
+}
+
+// Submits a callable task that is cancelled by a stop request on the token
+template <class Func>
+std::future<CancellableResult<Func>> WSThreadPool::submit(Func func, std::stop_token token) {
+	CancellableTask<Func> task{std::move(func), std::move(token)};
+	auto future{ task.getFuture() };
+	post(std::move(task));
 	return future;
 }
 
+// Submit a callable task without a future
+template <class Func>
+void WSThreadPool::post(Func func) {
+	// Workers of this pool push to their own queue. Other threads, including workers of other pools, use the main queue
+	Worker* local = localWorker();
+	if (!local) {
+		postToMainQueue(std::move(func));
+		return;
+	}
+	auto enqueued = m_taskTiming.load(std::memory_order_relaxed) ? Clock::now() : Clock::time_point{};
+	pushLocal(*local, local->cache.allocate(Task(std::move(func)), enqueued));
+}
+
+// Submit the task held in a node that the caller owns
+inline void WSThreadPool::postNode(TaskNode* node) {
+	Worker* local = localWorker();
+	if (!local) {
+		postToMainQueue(std::move(node->task));
+		return;
+	}
+	node->enqueued = m_taskTiming.load(std::memory_order_relaxed) ? Clock::now() : Clock::time_point{};
+	pushLocal(*local, node);
+}
+
+inline void WSThreadPool::pushLocal(Worker& worker, TaskNode* node) {
+	// The new task replaces the one in the LIFO slot, which moves to the deque
+	if (m_stealPolicy.lifoSlot)
+		node = worker.lifoSlot.exchange(node, std::memory_order_acq_rel);
+	if (node)
+		worker.queue.push(node);
+	m_idleEvent.notifyOne();
+}
+
+// Submit a callable task without a future to the main queue
+template <class Func>
+void WSThreadPool::postToMainQueue(Func func) {
+	auto enqueued = m_taskTiming.load(std::memory_order_relaxed) ? Clock::now() : Clock::time_point{};
+	Shard& shard = *m_mainQueues[threadHash() % m_mainQueues.size()];
+	shard.push(QueuedTask{ Task(std::move(func)), enqueued });
+	shard.size.fetch_add(1, std::memory_order_relaxed);
+	m_idleEvent.notifyOne();
+}
+
+// Submit a callable task once the delay has passed
+template <class Func>
+std::pair<TimerWheel::TimerId, std::future<typename std::invoke_result<Func>::type>> WSThreadPool::submitAfter(TimerWheel::Clock::duration delay, Func func) {
+	using ResultType = typename std::invoke_result<Func>::type;
+	std::packaged_task<ResultType()> task{std::move(func)};
+	auto future{ task.get_future() };
+	auto timer = postAfter(delay, std::move(task));
+	return { timer, std::move(future) };
+}
+
+// Submit a callable task without a future once the delay has passed
+template <class Func>
+TimerWheel::TimerId WSThreadPool::postAfter(TimerWheel::Clock::duration delay, Func func) {
+	// The timer thread only moves the callable into the pool's queue
+	return timers().schedule(delay, TimerWheel::Clock::duration::zero(), [this, func = std::move(func)]() mutable { post(std::move(func)); });
+}
+
+// Submit a callable task every period
+template <class Func>
+TimerWheel::TimerId WSThreadPool::submitEvery(TimerWheel::Clock::duration period, Func func) {
+	auto shared = std::make_shared<Func>(std::move(func));
+	return timers().schedule(period, period, [this, shared]() { post([shared]() { (*shared)(); }); });
+}
+
 // Check if the given future is ready
 template <class T>
-static bool WSThreadPool::isFutureReady(std::future<T>& future) {
+bool WSThreadPool::isFutureReady(std::future<T>& future) {
 	return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
 }
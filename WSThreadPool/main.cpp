@@ -1,4 +1,5 @@
 #include "WSThreadPool.hpp"
+#include "Future.hpp"
 #include <vector>
 #include <iostream>
 #include <string>
@@ -6,9 +7,13 @@
 #include <random>
 #include <algorithm>
 #include <chrono>
+#include <atomic>
+#include <latch>
 
 // Create a thread pool
 WSThreadPool pool(12);
+// Ranges smaller than this are sorted without submitting tasks
+size_t chunkSize = 100000;
 
 // Median of Three partition
 size_t partition(std::vector<int>& arr, size_t p, size_t r) {
@@ -33,9 +38,10 @@ size_t partition(std::vector<int>& arr, size_t p, size_t r) {
 	return i;
 }
 
-// Parallel sort
+// Parallel quicksort used to exercise work stealing
+// Lomuto partitioning degrades on inputs with many duplicates. Use parallelSort or parallelRadixSort
+// in ParallelAlgorithms/ParallelSort.hpp to sort real data
 void sort(std::vector<int>& vec, size_t from, size_t to) {
-	const static size_t chunkSize = 100000;
 	if (from >= to || to >= vec.size()) // 'to >= vec.size()' is needed to check if 'to' is underflowed
 		return;
 	size_t mid = partition(vec, from, to);
@@ -46,22 +52,178 @@ void sort(std::vector<int>& vec, size_t from, size_t to) {
 	}
 	// Pass the smaller job to the pool
 	else {
-		std::future<void> future;
+		Future<void> future;
 		if (mid - from < to - mid) {
-			future = pool.submit(std::bind(sort, std::ref(vec), from, mid - 1));
+			future = spawn(pool, [&vec, from, mid]() { sort(vec, from, mid - 1); });
 			sort(vec, mid + 1, to);
 		}
 		else {
-			future = pool.submit(std::bind(sort, std::ref(vec), mid + 1, to));
+			future = spawn(pool, [&vec, mid, to]() { sort(vec, mid + 1, to); });
 			sort(vec, from, mid - 1);
 		}
-		// Run other jobs in the pool if the future is not ready
-		while (!WSThreadPool::isFutureReady(future))
-			pool.runPendingTask();
+		// Run other jobs in the pool until the future is ready
+		future.wait(pool);
 		future.get();
 	}
 }
 
+// Tasks of a CPU pool hand blocking work to a separate pool
+// Each submission must land in the pool it was submitted to, not in the submitting worker's queue
+void twoPools() {
+	WSThreadPool cpuPool(4);
+	WSThreadPool blockingPool(2);
+	std::vector<std::future<bool>> futures;
+	for (size_t i = 0; i < 100; ++i) {
+		futures.emplace_back(cpuPool.submit([&]() {
+			auto inner = blockingPool.submit([&]() {
+				std::this_thread::sleep_for(std::chrono::microseconds(100));
+				return blockingPool.isWorkerThread() && !cpuPool.isWorkerThread();
+			});
+			// Help the CPU pool while waiting. This never runs the blocking task
+			while (!WSThreadPool::isFutureReady(inner))
+				cpuPool.runPendingTask();
+			return inner.get();
+		}));
+	}
+	bool allOnBlockingPool = true;
+	for (auto& future : futures)
+		allOnBlockingPool = future.get() && allOnBlockingPool;
+	std::cout << "Blocking tasks ran on the blocking pool: " << std::boolalpha << allOnBlockingPool << "\n";
+}
+// Several threads outside the pool post small tasks at the same time
+void benchmarkInjection(size_t numMainQueues) {
+	constexpr size_t numProducers{8};
+	constexpr size_t tasksPerProducer{100000};
+	WSThreadPool injectionPool(4, {}, {}, numMainQueues);
+	std::atomic<size_t> done{0};
+	std::latch latch{numProducers};
+	auto t1 = std::chrono::steady_clock::now();
+	{
+		std::vector<std::jthread> producers;
+		for (size_t i = 0; i < numProducers; ++i) {
+			producers.emplace_back([&]() {
+				latch.arrive_and_wait();
+				for (size_t j = 0; j < tasksPerProducer; ++j)
+					injectionPool.post([&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+			});
+		}
+	}
+	while (done.load() < numProducers * tasksPerProducer)
+		std::this_thread::yield();
+	auto t2 = std::chrono::steady_clock::now();
+	std::cout << numProducers << " producers, " << (numMainQueues ? numMainQueues : 4) << " main queue shard(s): "
+		<< std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count() << "ms\n";
+}
+
+// Chain of tasks where every task posts its continuation
+// Counts how often the continuation runs on a different thread than its parent
+struct Chain {
+	WSThreadPool& pool;
+	size_t remaining;
+	size_t migrations{0};
+	std::atomic<bool> done{false};
+	void step(std::thread::id parent) {
+		if (std::this_thread::get_id() != parent)
+			++migrations;
+		if (--remaining == 0) {
+			done = true;
+			return;
+		}
+		pool.post([this, id = std::this_thread::get_id()]() { step(id); });
+	}
+};
+
+// Binary fork-join tree of tiny tasks
+void forkJoin(WSThreadPool& forkPool, std::atomic<size_t>& leaves, int depth) {
+	if (depth == 0) {
+		leaves.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	forkPool.post([&forkPool, &leaves, depth]() { forkJoin(forkPool, leaves, depth - 1); });
+	forkPool.post([&forkPool, &leaves, depth]() { forkJoin(forkPool, leaves, depth - 1); });
+}
+
+// Compare continuation latency and fork-join time with and without the LIFO slot
+void benchmarkLifoSlot(bool lifoSlot) {
+	WSThreadPool lifoPool(4, {}, StealPolicy{ .lifoSlot = lifoSlot });
+
+	Chain chain{lifoPool, 100000};
+	auto t1 = std::chrono::steady_clock::now();
+	lifoPool.post([&chain]() { chain.step(std::this_thread::get_id()); });
+	while (!chain.done.load())
+		std::this_thread::yield();
+	auto t2 = std::chrono::steady_clock::now();
+
+	constexpr int depth{18};
+	std::atomic<size_t> leaves{0};
+	lifoPool.post([&]() { forkJoin(lifoPool, leaves, depth); });
+	while (leaves.load() < (size_t{1} << depth))
+		std::this_thread::yield();
+	auto t3 = std::chrono::steady_clock::now();
+
+	std::cout << "LIFO slot " << (lifoSlot ? "on" : "off") << ": "
+		<< std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count() / 100000 << "ns per continuation, "
+		<< chain.migrations << " migrations, fork-join "
+		<< std::chrono::duration_cast<std::chrono::milliseconds>(t3 - t2).count() << "ms\n";
+}
+
+// Fork-join and steal counters with workers left to the OS scheduler and with workers pinned by cache domain
+void benchmarkPlacement(bool pinWorkers) {
+	size_t numThreads = std::max(std::thread::hardware_concurrency(), 4u);
+	WSThreadPool placedPool(numThreads, {}, {}, 0, 0, Placement{ .pinWorkers = pinWorkers });
+	constexpr int depth{18};
+	std::atomic<size_t> leaves{0};
+	auto t1 = std::chrono::steady_clock::now();
+	placedPool.post([&]() { forkJoin(placedPool, leaves, depth); });
+	while (leaves.load() < (size_t{1} << depth))
+		std::this_thread::yield();
+	auto t2 = std::chrono::steady_clock::now();
+	auto stats = placedPool.getStealStats();
+	std::cout << (pinWorkers ? "pinned" : "unpinned") << ": fork-join " << std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count()
+		<< "ms, steal attempts: " << stats.attempts << ", success rate: " << stats.successRate() << "\n";
+}
+
+// Per-worker counters and latency histograms of a fork-join run, half of it submitted from outside the pool
+void printMetrics() {
+	constexpr int depth{16};
+	WSThreadPool metricsPool(4);
+	metricsPool.setTaskTiming(true);
+	std::atomic<size_t> leaves{0};
+	metricsPool.post([&]() { forkJoin(metricsPool, leaves, depth); });
+	for (size_t i = 0; i < (size_t{1} << depth); ++i)
+		metricsPool.post([&leaves]() { leaves.fetch_add(1, std::memory_order_relaxed); });
+	while (leaves.load() < (size_t{2} << depth))
+		std::this_thread::yield();
+	auto metrics = metricsPool.snapshot();
+	auto total = metrics.total();
+	std::cout << "Metrics: " << total.tasksExecuted << " tasks executed, per worker (executed/stolen/queued):";
+	for (size_t i = 0; i < metricsPool.getNumThreads(); ++i)
+		std::cout << " " << metrics.workers[i].tasksExecuted << "/" << metrics.workers[i].tasksStolen << "/" << metrics.workers[i].queueDepth;
+	size_t injected = 0;
+	for (size_t depth : metrics.injectorDepth)
+		injected += depth;
+	std::cout << ", main queue " << injected << "\n  steal attempts " << total.stealAttempts << ", successes " << total.stealSuccesses
+		<< ", spin " << total.spinTime.count() / 1000 << "us, yield " << total.yieldTime.count() / 1000 << "us, park " << total.parkTime.count() / 1000 << "us\n"
+		<< "  queue wait p50 " << metrics.queueWait.percentile(0.5).count() << "ns, p99 " << metrics.queueWait.percentile(0.99).count()
+		<< "ns / run time p50 " << metrics.runTime.percentile(0.5).count() << "ns, p99 " << metrics.runTime.percentile(0.99).count() << "ns\n";
+}
+
+// Shrink the pool while a worker's local queue is full of tasks. The retiring workers hand them over to the main queue
+void resizeWithLocalTasks() {
+	constexpr size_t numTasks{100000};
+	WSThreadPool pool(4, {}, {}, 0, 8);
+	std::atomic<size_t> counter{0};
+	pool.post([&pool, &counter]() {
+		for (size_t i = 0; i < numTasks; ++i)
+			pool.post([&counter]() { counter.fetch_add(1, std::memory_order_relaxed); });
+	});
+	for (size_t numThreads : {1, 8, 2, 1})
+		pool.resize(numThreads);
+	pool.startAutoscaling(ScalingPolicy{ .minThreads = 1, .maxThreads = 8 });
+	while (counter.load() < numTasks)
+		std::this_thread::yield();
+	std::cout << "Resized 4 -> 1 -> 8 -> 2 -> 1 with queued tasks, all ran: " << std::boolalpha << (counter.load() == numTasks) << "\n";
+}
 
 int main() {
 	// Make a random vector of length 10000000
@@ -94,6 +256,103 @@ int main() {
 	Time taken for parallel sorting: 589ms
 	Time taken for std::sort: 3488ms
 	*/
+
+	// Steal-heavy runs: smaller chunks create more tasks, so workers steal more often
+	for (size_t size : {10000, 1000, 100}) {
+		chunkSize = size;
+		auto vec = copy;
+		std::shuffle(vec.begin(), vec.end(), gen);
+		auto statsBefore = pool.getStealStats();
+		auto t4 = std::chrono::steady_clock::now();
+		sort(vec, 0, vec.size() - 1);
+		auto t5 = std::chrono::steady_clock::now();
+		auto statsAfter = pool.getStealStats();
+		StealStats stats{ statsAfter.attempts - statsBefore.attempts, statsAfter.successes - statsBefore.successes,
+			statsAfter.tasksStolen - statsBefore.tasksStolen };
+		std::cout << "Chunk size " << size << ": " << std::chrono::duration_cast<std::chrono::milliseconds>(t5 - t4).count() << "ms"
+			<< ", sorted: " << std::boolalpha << std::is_sorted(vec.begin(), vec.end())
+			<< ", steal attempts: " << stats.attempts << ", success rate: " << stats.successRate()
+			<< ", tasks stolen: " << stats.tasksStolen << "\n";
+	}
+
+	// Two pools in one process
+	twoPools();
+	/*
+	Blocking tasks ran on the blocking pool: true
+	*/
+
+	// External producers with a single main queue and with one shard per worker
+	benchmarkInjection(1);
+	benchmarkInjection(0);
+
+	// Continuations and fork-join with and without the LIFO slot
+	benchmarkLifoSlot(false);
+	benchmarkLifoSlot(true);
+	/* Possible result (4 workers on a single core machine):
+	LIFO slot off: 59ns per continuation, 0 migrations, fork-join 25ms
+	LIFO slot on: 55ns per continuation, 2 migrations, fork-join 29ms
+	*/
+
+	// Pin workers and steal within a cache domain first
+	auto topology = CpuTopology::detect();
+	std::vector<unsigned> cores, domains;
+	for (const Cpu& cpu : topology.cpus()) {
+		if (std::find(cores.begin(), cores.end(), cpu.core) == cores.end())
+			cores.push_back(cpu.core);
+		if (std::find(domains.begin(), domains.end(), cpu.cacheDomain) == domains.end())
+			domains.push_back(cpu.cacheDomain);
+	}
+	std::cout << topology.cpus().size() << " CPUs, " << cores.size() << " cores, " << domains.size() << " cache domains\n";
+	benchmarkPlacement(false);
+	benchmarkPlacement(true);
+	/* Possible result (single core machine):
+	1 CPUs, 1 cores, 1 cache domains
+	unpinned: fork-join 21ms, steal attempts: 819, success rate: 0.019536
+	pinned: fork-join 22ms, steal attempts: 850, success rate: 0.02
+	*/
+
+	// What the workers have been doing
+	printMetrics();
+	/* Possible result (single core machine):
+	Metrics: 196607 tasks executed, per worker (executed/stolen/queued): 24567/0/0 36501/3/0 65745/16/0 69794/11/0, main queue 0
+	  steal attempts 1026, successes 12, spin 36us, yield 1607us, park 0us
+	  queue wait p50 512ns, p99 9437184ns / run time p50 48ns, p99 192ns
+	*/
+
+	// Delayed tasks are posted to the pool by its timer thread
+	auto [timer, delayed] = pool.submitAfter(std::chrono::milliseconds(10), []() { return pool.isWorkerThread(); });
+	auto cancelled = pool.postAfter(std::chrono::seconds(1), []() { std::cout << "never printed\n"; });
+	std::cout << "Delayed task ran on a worker: " << std::boolalpha << delayed.get() << ", cancelled: " << pool.cancelTimer(cancelled) << "\n";
+	/*
+	Delayed task ran on a worker: true, cancelled: true
+	*/
+
+	// A stop request discards the tasks that have not started
+	std::stop_source group;
+	std::vector<std::future<size_t>> groupFutures;
+	for (size_t i = 0; i < 100; ++i)
+		groupFutures.emplace_back(pool.submit([i](std::stop_token token) { return token.stop_requested() ? 0 : i; }, group.get_token()));
+	group.request_stop();
+	size_t ran = 0, cancelledTasks = 0;
+	for (auto& future : groupFutures) {
+		try {
+			future.get();
+			++ran;
+		}
+		catch (const TaskCancelled&) {
+			++cancelledTasks;
+		}
+	}
+	std::cout << "Stop requested: " << ran << " tasks ran, " << cancelledTasks << " cancelled\n";
+	/* Possible result:
+	Stop requested: 3 tasks ran, 97 cancelled
+	*/
+
+	// Retiring workers redistribute their local queues
+	resizeWithLocalTasks();
+	/*
+	Resized 4 -> 1 -> 8 -> 2 -> 1 with queued tasks, all ran: true
+	*/
 	
 	return 0;
 }
\ No newline at end of file